@@ -4,23 +4,429 @@
 #include <algorithm>
 #include <numeric>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <iterator>
+#include <cstdint>
+#include <chrono>
+#include <cstddef>
+#include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <optional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-template<typename KeyType>
-class BTreeNode {
+// 树节点使用的定长连续数组：容量在构造时由 t 决定，之后不再扩容，
+// 元素在一块连续内存里，接口与原来的 std::deque 用法保持一致。
+// 可以自己分配缓冲区，也可以使用外部给的缓冲区（与节点放在同一块内存里），后者析构时只析构元素
+template<typename T>
+class NodeArray {
+public:
+    using slot_type = T;  // 外部缓冲区每个元素占一个 slot
+    using const_reference = const T&;
+
+    explicit NodeArray(size_t capacity) : buf(new T[capacity]), n(0), cap(capacity), owned(true) {}
+    NodeArray(T* storage, size_t capacity) : buf(storage), n(0), cap(capacity), owned(false) {
+        std::uninitialized_value_construct_n(buf, cap);
+    }
+    ~NodeArray() {
+        if (owned) delete[] buf;
+        else std::destroy_n(buf, cap);
+    }
+    NodeArray(const NodeArray&) = delete;
+    NodeArray& operator=(const NodeArray&) = delete;
+
+    size_t size() const { return n; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return n == 0; }
+    T* data() { return buf; }
+    const T* data() const { return buf; }
+    T* begin() { return buf; }
+    T* end() { return buf + n; }
+    const T* begin() const { return buf; }
+    const T* end() const { return buf + n; }
+    T& operator[](size_t i) { return buf[i]; }
+    const T& operator[](size_t i) const { return buf[i]; }
+    T& at(size_t i) {
+        if (i >= n) throw std::out_of_range("NodeArray::at");
+        return buf[i];
+    }
+    void set(size_t i, const T& v) { buf[i] = v; }
+    T& front() { return buf[0]; }
+    T& back() { return buf[n - 1]; }
+
+    void push_back(const T& v) { buf[n++] = v; }
+    void push_back(T&& v) { buf[n++] = std::move(v); }
+    void pop_back() { buf[--n] = T(); }
+    void pop_front() { erase(begin()); }
+    void clear() { resize(0); }
+
+    // 缩小时把多出的槽位重置，释放其持有的资源（如 std::string）
+    void resize(size_t m) {
+        for (size_t i = m; i < n; ++i) buf[i] = T();
+        n = m;
+    }
+
+    T* insert(T* pos, const T& v) {
+        std::move_backward(pos, end(), end() + 1);
+        *pos = v;
+        ++n;
+        return pos;
+    }
+
+    T* insert(T* pos, T&& v) {
+        std::move_backward(pos, end(), end() + 1);
+        *pos = std::move(v);
+        ++n;
+        return pos;
+    }
+
+    template<typename It>
+    T* insert(T* pos, It first, It last) {
+        size_t cnt = std::distance(first, last);
+        std::move_backward(pos, end(), end() + cnt);
+        std::copy(first, last, pos);
+        n += cnt;
+        return pos;
+    }
+
+    T* erase(T* pos) {
+        std::move(pos + 1, end(), pos);
+        pop_back();
+        return pos;
+    }
+
+    template<typename It>
+    void assign(It first, It last) {
+        clear();
+        for (; first != last; ++first) buf[n++] = *first;
+    }
+
+private:
+    T* buf;
+    size_t n;
+    size_t cap;
+    bool owned;
+};
+
+// 节点内存分配接口：树的节点连同节点内的数组放在一块内存里，整块通过它分配和归还。
+// 返回的内存按 alignof(std::max_align_t) 对齐
+class NodeAllocator {
+public:
+    virtual ~NodeAllocator() = default;
+    virtual void* allocate(size_t bytes) = 0;
+    virtual void deallocate(void* p, size_t bytes) = 0;
+};
+
+// 每个节点单独向全局 operator new 申请
+class HeapNodeAllocator : public NodeAllocator {
+public:
+    // 为 true 表示 release() 能一次性收回所有块，树析构时不必逐个释放节点
+    static constexpr bool releasesAll = false;
+    void* allocate(size_t bytes) override {
+        void* p = ::operator new(bytes);
+        ++live;
+        return p;
+    }
+    void deallocate(void* p, size_t) override {
+        ::operator delete(p);
+        --live;
+    }
+    void release() {}
+    // 尚未归还的块数
+    size_t liveBlocks() const { return live; }
+private:
+    size_t live = 0;
+};
+
+constexpr size_t cacheLineBytes = 64;
+
+// 每棵树独享的 slab 分配器：按块大小分类，每类从整块 slab 中顺序切出，
+// 归还的块挂到该类的空闲链表上优先复用。release() 只释放 slab，不访问单个节点。
+// slab 按缓存行对齐，大小为整数条缓存行的块也就都落在缓存行边界上
+class SlabArena : public NodeAllocator {
+public:
+    static constexpr bool releasesAll = true;
+
+    explicit SlabArena(size_t _blocksPerSlab = 64) : blocksPerSlab(_blocksPerSlab) {}
+    ~SlabArena() { release(); }
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    void* allocate(size_t bytes) override {
+        SizeClass& c = classFor(roundUp(bytes));
+        ++live;
+        if (c.freeList) {
+            FreeBlock* b = c.freeList;
+            c.freeList = b->next;
+            return b;
+        }
+        if (c.cur == c.end) {
+            char* slab = static_cast<char*>(::operator new(c.bytes * blocksPerSlab, std::align_val_t(cacheLineBytes)));
+            slabs.push_back(slab);
+            c.cur = slab;
+            c.end = slab + c.bytes * blocksPerSlab;
+        }
+        void* p = c.cur;
+        c.cur += c.bytes;
+        return p;
+    }
+
+    void deallocate(void* p, size_t bytes) override {
+        SizeClass& c = classFor(roundUp(bytes));
+        FreeBlock* b = static_cast<FreeBlock*>(p);
+        b->next = c.freeList;
+        c.freeList = b;
+        --live;
+    }
+
+    // 释放全部 slab，之前分配的块全部失效
+    void release() {
+        for (char* slab : slabs) ::operator delete(slab, std::align_val_t(cacheLineBytes));
+        slabs.clear();
+        classes.clear();
+        live = 0;
+    }
+    size_t liveBlocks() const { return live; }
+
+private:
+    struct FreeBlock { FreeBlock* next; };
+    struct SizeClass {
+        size_t bytes;
+        FreeBlock* freeList;
+        char* cur;
+        char* end;
+    };
+
+    size_t blocksPerSlab;
+    size_t live = 0;
+    std::vector<SizeClass> classes;  // 一棵树只有两三种节点大小，线性查找即可
+    std::vector<char*> slabs;
+
+    static size_t roundUp(size_t bytes) {
+        const size_t a = alignof(std::max_align_t);
+        return (std::max(bytes, sizeof(FreeBlock)) + a - 1) / a * a;
+    }
+
+    SizeClass& classFor(size_t bytes) {
+        for (auto& c : classes)
+            if (c.bytes == bytes) return c;
+        classes.push_back({ bytes, nullptr, nullptr, nullptr });
+        return classes.back();
+    }
+};
+
+// 节点对象之后依次放各个数组，每段按各自类型对齐
+constexpr size_t nodeAlignUp(size_t offset, size_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+// 节点和树的最小度数 t：FixedT 为 0 时在运行时给出并存在对象里；
+// 否则 t 是编译期常量，不占对象空间，容量、节点大小等都随之成为常量
+template<typename Int, size_t FixedT>
+struct DegreeHolder {
+    static_assert(FixedT >= 2, "minimum degree must be at least 2");
+    static constexpr Int t = Int(FixedT);
+    explicit DegreeHolder(Int m) {
+        if (m != t) throw std::invalid_argument("degree differs from the template parameter");
+    }
+};
+
+template<typename Int>
+struct DegreeHolder<Int, 0> {
+    Int t;
+    explicit DegreeHolder(Int m) : t(m) {}
+};
+
+// 编译时定义 BTREE_STATS=1 打开操作计数与延迟统计（BTree / BPlusTree）；
+// 默认关闭，此时下面的计数宏展开为空，树中也没有计数器成员
+#ifndef BTREE_STATS
+#define BTREE_STATS 0
+#endif
+
+enum class TreeOp { Insert, Find, Erase, Batch };
+constexpr size_t treeOpCount = 4;
+
+// 运行时计数：结构调整次数、节点访问次数，以及每类操作的延迟和访问节点数分布
+struct TreeOpCounters {
+    size_t splits = 0;           // splitChild，含根分裂
+    size_t fills = 0;            // 删除后孩子 key 不足，进入 fill
+    size_t borrowsFromPrev = 0;
+    size_t borrowsFromNext = 0;
+    size_t merges = 0;           // merge / mergePrev / mergeNext
+    size_t nodeVisits = 0;       // 节点内查找（findKey）次数
+    size_t ops[treeOpCount] = {};
+    // latency[op][b]：耗时落在 [2^(b-1), 2^b) ns 的次数
+    size_t latency[treeOpCount][32] = {};
+    // visits[op][v]：一次操作访问了 v 个节点的次数，超过 15 记在最后一格
+    size_t visits[treeOpCount][16] = {};
+
+    // 第 q 分位（0~1）延迟所在桶的上界，单位 ns；没有记录时为 0
+    size_t latencyPercentile(TreeOp op, double q) const {
+        size_t total = ops[size_t(op)], seen = 0;
+        if (total == 0) return 0;
+        for (size_t b = 0; b < 32; ++b) {
+            seen += latency[size_t(op)][b];
+            if (seen >= q * total) return size_t(1) << b;
+        }
+        return size_t(1) << 31;
+    }
+};
+
+// 树的统计快照：结构部分由 stats() 遍历整棵树得到，随时可用；ops 只在 BTREE_STATS=1 时有数据
+struct TreeStats {
+    size_t height = 0;
+    size_t nodes = 0;
+    size_t keys = 0;       // 存放的元素数（B+ 树只算叶子）
+    size_t bytes = 0;      // 节点块字节数（含 key 数组放在堆上的部分）
+    size_t capacity = 0;   // 每个节点最多的 key 数
+    std::vector<size_t> nodesPerLevel;  // [0] 为根所在层
+    size_t fillHistogram[10] = {};      // 节点 key 数 / capacity，按 10% 分桶
+    TreeOpCounters ops;
+
+    void addNode(size_t nKeys, size_t blockBytes) {
+        ++nodes;
+        bytes += blockBytes;
+        fillHistogram[std::min<size_t>(9, nKeys * 10 / capacity)]++;
+    }
+
+    void print(std::ostream& os) const {
+        os << "height " << height << ", " << nodes << " nodes, " << keys << " keys, " << bytes << " bytes\n";
+        os << "nodes per level:";
+        for (size_t c : nodesPerLevel) os << " " << c;
+        os << "\nfill:";
+        for (size_t b = 0; b < 10; ++b) os << " " << b * 10 << "%:" << fillHistogram[b];
+        os << "\n";
+        size_t total = 0;
+        for (size_t c : ops.ops) total += c;
+        if (total == 0) return;
+        os << "splits " << ops.splits << ", fills " << ops.fills << ", borrows " << ops.borrowsFromPrev << "+"
+           << ops.borrowsFromNext << ", merges " << ops.merges << "\n";
+        const char* names[treeOpCount] = { "insert", "find", "erase", "batch" };
+        for (size_t op = 0; op < treeOpCount; ++op) {
+            if (ops.ops[op] == 0) continue;
+            size_t v = 0;
+            for (size_t i = 0; i < 16; ++i) v += i * ops.visits[op][i];
+            os << names[op] << ": " << ops.ops[op] << " ops, " << double(v) / ops.ops[op] << " nodes/op, p50 <"
+               << ops.latencyPercentile(TreeOp(op), 0.5) << "ns, p99 <" << ops.latencyPercentile(TreeOp(op), 0.99)
+               << "ns\n";
+        }
+    }
+};
+
+#if BTREE_STATS
+// 当前线程正在执行的树操作的计数器，节点代码通过 BTREE_COUNT 累加
+inline thread_local TreeOpCounters* treeStatsSink = nullptr;
+
+// 一次公开操作的统计范围：计时并记录访问节点数。同一棵树内嵌套调用
+// （如 insertBatch 中的 insertImpl）只由最外层记录
+class TreeStatsScope {
+public:
+    TreeStatsScope(TreeOpCounters& c, TreeOp _op) : counters(c), prev(treeStatsSink), op(size_t(_op)) {
+        if (prev == &counters) return;
+        treeStatsSink = &counters;
+        visits0 = counters.nodeVisits;
+        start = std::chrono::steady_clock::now();
+    }
+    ~TreeStatsScope() {
+        if (prev == &counters) return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        size_t b = 0;
+        while (b < 31 && (size_t(1) << b) <= size_t(ns)) ++b;
+        counters.ops[op]++;
+        counters.latency[op][b]++;
+        counters.visits[op][std::min<size_t>(15, counters.nodeVisits - visits0)]++;
+        treeStatsSink = prev;
+    }
+    TreeStatsScope(const TreeStatsScope&) = delete;
+    TreeStatsScope& operator=(const TreeStatsScope&) = delete;
+private:
+    TreeOpCounters& counters;
+    TreeOpCounters* prev;
+    size_t op;
+    size_t visits0 = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define BTREE_COUNT(field) (treeStatsSink ? (void)++treeStatsSink->field : (void)0)
+#define BTREE_STATS_SCOPE(op) TreeStatsScope treeStatsScope_(opCounters, op)
+#else
+#define BTREE_COUNT(field) ((void)0)
+#define BTREE_STATS_SCOPE(op) ((void)0)
+#endif
+
+// 容量编译期已知时的节点内查找，定义在 nodeLowerBound 之后
+template<size_t Cap, typename T>
+inline size_t fixedLowerBound(const T* a, size_t n, const T& k);
+
+// T 不为 0 时最小度数在编译期确定，见 DegreeHolder
+template<typename KeyType, size_t T = 0>
+class BTreeNode : public DegreeHolder<int, T> {
+    static_assert(alignof(KeyType) <= alignof(std::max_align_t), "node blocks are max_align_t aligned");
 public:
+    using DegreeHolder<int, T>::t;  // 最小度数
     bool isLeaf;
     int nKeys;
-    std::vector<KeyType> keys;
-    std::vector<BTreeNode*> children;
-    int t;  // 最小度数
-    BTreeNode(int _t, bool _isLeaf)
-        : isLeaf(_isLeaf), nKeys(0), t(_t) {
-        // keys 最多 2t-1, children 最多 2t
-        keys.reserve(2 * t - 1);
-        children.reserve(2 * t);
+    NodeArray<KeyType> keys;
+    NodeArray<BTreeNode*> children;
+    NodeAllocator* alloc;  // 分配本节点的分配器，分裂出的新节点也从这里分配
+
+    // 节点和 keys/children 数组在同一块内存里：keys 最多 2t-1, children 最多 2t，叶子不留 children
+    static BTreeNode* create(NodeAllocator* a, int t, bool isLeaf) {
+        char* p = static_cast<char*>(a->allocate(blockSize(t, isLeaf)));
+        KeyType* keyBuf = reinterpret_cast<KeyType*>(p + keysOffset());
+        BTreeNode** childBuf = reinterpret_cast<BTreeNode**>(p + childrenOffset(t));
+        return new (p) BTreeNode(a, t, isLeaf, keyBuf, childBuf);
+    }
+
+    // 析构并把整块内存还给分配器
+    void dispose() {
+        NodeAllocator* a = alloc;
+        size_t bytes = blockSize(t, isLeaf);
+        this->~BTreeNode();
+        a->deallocate(this, bytes);
+    }
+
+    static constexpr size_t keysOffset() { return nodeAlignUp(sizeof(BTreeNode), alignof(KeyType)); }
+    static constexpr size_t childrenOffset(int t) {
+        return nodeAlignUp(keysOffset() + (2 * t - 1) * sizeof(KeyType), alignof(BTreeNode*));
     }
+    // 编译期度数的节点补齐到整数条缓存行
+    static constexpr size_t blockSize(int t, bool isLeaf) {
+        size_t bytes = isLeaf ? keysOffset() + (2 * t - 1) * sizeof(KeyType)
+                              : childrenOffset(t) + 2 * t * sizeof(BTreeNode*);
+        return T ? nodeAlignUp(bytes, cacheLineBytes) : bytes;
+    }
+
+    BTreeNode(NodeAllocator* a, int _t, bool _isLeaf, KeyType* keyBuf, BTreeNode** childBuf)
+        : DegreeHolder<int, T>(_t), isLeaf(_isLeaf), nKeys(0), keys(keyBuf, 2 * _t - 1),
+          children(childBuf, _isLeaf ? 0 : 2 * _t), alloc(a) {}
+    BTreeNode(const BTreeNode&) = delete;
+    BTreeNode& operator=(const BTreeNode&) = delete;
     // 查找 key 在节点中的索引或应插入位置
     int findKey(const KeyType& k) {
+        BTREE_COUNT(nodeVisits);
+        if constexpr (T != 0)
+            return static_cast<int>(fixedLowerBound<2 * T - 1>(keys.data(), nKeys, k));
         int idx = 0;
         // 线性查找也可换二分：std::lower_bound
         while (idx < nKeys && keys[idx] < k)
@@ -56,8 +462,9 @@ public:
 
     // 分裂 children[idx]
     void splitChild(int idx) {
+        BTREE_COUNT(splits);
         BTreeNode* y = children[idx];
-        BTreeNode* z = new BTreeNode(y->t, y->isLeaf);
+        BTreeNode* z = create(alloc, y->t, y->isLeaf);
         z->nKeys = t - 1;
         // 将 y.keys[t..2t-2] 移至 z
         for (int j = 0; j < t - 1; ++j)
@@ -106,8 +513,8 @@ public:
         return children[i]->search(k);
     }
 
-    // 删除 key 的公共接口
-    void remove(const KeyType& k) {
+    // 删除 key 的公共接口，返回 key 是否存在
+    bool remove(const KeyType& k) {
         int idx = findKey(k);
         if (idx < nKeys && keys[idx] == k) {
             // key 在此节点
@@ -115,17 +522,15 @@ public:
                 // 叶子节点直接删除
                 keys.erase(keys.begin() + idx);
                 nKeys--;
+                return true;
             }
-            else {
-                removeFromNonLeaf(idx);
-            }
+            return removeFromNonLeaf(idx);
         }
         else {
             // key 不在此节点
             if (isLeaf) {
                 // 不存在
-                std::cout << "Key " << k << " does not exist in the tree\n";
-                return;
+                return false;
             }
             // 决定进入子节点 children[idx]
             bool flag = (idx == nKeys);
@@ -135,32 +540,29 @@ public:
             }
             // 如果最初 idx==nKeys，并且 fill 导致合并后 children[idx-1]，则递归在 children[idx-1]
             if (flag && idx > nKeys)
-                children[idx - 1]->remove(k);
-            else
-                children[idx]->remove(k);
+                return children[idx - 1]->remove(k);
+            return children[idx]->remove(k);
         }
     }
 
     // 从非叶节点删除 keys[idx]
-    void removeFromNonLeaf(int idx) {
+    bool removeFromNonLeaf(int idx) {
         KeyType k = keys[idx];
         // 前驱子树 children[idx]
         if (children[idx]->nKeys >= t) {
             KeyType pred = getPredecessor(idx);
             keys[idx] = pred;
-            children[idx]->remove(pred);
+            return children[idx]->remove(pred);
         }
         // 后继子树 children[idx+1]
         else if (children[idx + 1]->nKeys >= t) {
             KeyType succ = getSuccessor(idx);
             keys[idx] = succ;
-            children[idx + 1]->remove(succ);
-        }
-        else {
-            // 两侧子节点都只有 t-1 个 key，合并 idx 和 idx+1
-            merge(idx);
-            children[idx]->remove(k);
+            return children[idx + 1]->remove(succ);
         }
+        // 两侧子节点都只有 t-1 个 key，合并 idx 和 idx+1
+        merge(idx);
+        return children[idx]->remove(k);
     }
 
     KeyType getPredecessor(int idx) {
@@ -179,6 +581,7 @@ public:
 
     // fill children[idx] 使其至少有 t 个关键字
     void fill(int idx) {
+        BTREE_COUNT(fills);
         // 如果前兄弟有多余，借
         if (idx > 0 && children[idx - 1]->nKeys >= t) {
             borrowFromPrev(idx);
@@ -197,6 +600,7 @@ public:
     }
 
     void borrowFromPrev(int idx) {
+        BTREE_COUNT(borrowsFromPrev);
         BTreeNode* child = children[idx];
         BTreeNode* sibling = children[idx - 1];
         // child 的 keys 后移，腾出位置
@@ -213,6 +617,7 @@ public:
     }
 
     void borrowFromNext(int idx) {
+        BTREE_COUNT(borrowsFromNext);
         BTreeNode* child = children[idx];
         BTreeNode* sibling = children[idx + 1];
         // 把父节点 keys[idx] 下移到 child
@@ -230,6 +635,7 @@ public:
 
     // 合并 children[idx] 和 children[idx+1]
     void merge(int idx) {
+        BTREE_COUNT(merges);
         BTreeNode* child = children[idx];
         BTreeNode* sibling = children[idx + 1];
         // 把父节点 keys[idx] 下移到 child
@@ -247,15 +653,35 @@ public:
         keys.erase(keys.begin() + idx);
         children.erase(children.begin() + idx + 1);
         nKeys--;
-        // 释放 sibling（可选）
-        delete sibling;
+        sibling->dispose();
     }
 };
 
-template<typename KeyType>
-class BTree {
+// 批量构建时把 n 个元素分成几组：每组目标 per 个，且每组不少于 lo 个（只分一组时不限）
+inline size_t bulkGroupCount(size_t n, size_t per, size_t lo) {
+    size_t byPer = (n + per - 1) / per;
+    size_t byMin = n / lo;
+    return std::max<size_t>(1, std::min(byPer, byMin));
+}
+
+// 按填充因子算出每个节点的目标元素数，限制在 [lo, hi]
+inline size_t bulkPerNode(double fillFactor, size_t lo, size_t hi) {
+    size_t per = static_cast<size_t>(fillFactor * hi + 0.5);
+    return std::min(hi, std::max(lo, std::max<size_t>(per, 1)));
+}
+
+// Alloc 为节点分配策略（SlabArena 或 HeapNodeAllocator），每棵树持有自己的一份
+// T 不为 0 时最小度数在编译期确定（见 FixedBTree），此时可以默认构造
+template<typename KeyType, typename Alloc = SlabArena, size_t T = 0>
+class BTree : DegreeHolder<int, T> {
 public:
-    BTree(int _t) : root(nullptr), t(_t) {}
+    BTree(int _t) : DegreeHolder<int, T>(_t), root(nullptr) {}
+    template<size_t U = T, typename = std::enable_if_t<U != 0>>
+    BTree() : BTree(int(U)) {}
+    ~BTree() { clear(); }
+    // 节点记录了本树分配器的地址，树不可拷贝或移动
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
 
     // 遍历
     void traverse() {
@@ -264,20 +690,22 @@ public:
     }
 
     // 搜索
-    BTreeNode<KeyType>* search(const KeyType& k) {
+    BTreeNode<KeyType, T>* search(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
         return root ? root->search(k) : nullptr;
     }
 
     // 插入
     void insert(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Insert);
         if (!root) {
-            root = new BTreeNode<KeyType>(t, true);
+            root = BTreeNode<KeyType, T>::create(&alloc, t, true);
             root->keys.push_back(k);
             root->nKeys = 1;
         }
         else {
             if (root->nKeys == 2 * t - 1) {
-                BTreeNode<KeyType>* s = new BTreeNode<KeyType>(t, false);
+                BTreeNode<KeyType, T>* s = BTreeNode<KeyType, T>::create(&alloc, t, false);
                 s->children.push_back(root);
                 root = s;
                 s->splitChild(0);
@@ -289,188 +717,1133 @@ public:
         }
     }
 
-    // 删除
-    void remove(const KeyType& k) {
-        if (!root) {
-            std::cout << "Empty tree\n";
-            return;
-        }
-        root->remove(k);
+    // 删除，返回 k 是否存在
+    bool remove(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Erase);
+        if (!root) return false;
+        bool found = root->remove(k);
         if (root->nKeys == 0) {
-            BTreeNode<KeyType>* tmp = root;
+            BTreeNode<KeyType, T>* tmp = root;
             if (root->isLeaf) {
-                delete root;
+                root->dispose();
                 root = nullptr;
             }
             else {
                 root = root->children[0];
-                delete tmp;
+                tmp->dispose();
             }
         }
+        return found;
     }
-private:
-    BTreeNode<KeyType>* root;
-    int t;
-};
 
+    // 从有序且无重复的 [first, last) 自底向上构建，替换原有内容
+    // 叶子按 fillFactor 从左到右填满，再逐层用相邻节点间的 key 作分隔建上层；
+    // 每个节点预留空位，之后插入不会立刻分裂
+    template<typename ForwardIt>
+    void bulkLoad(ForwardIt first, ForwardIt last, double fillFactor = 0.75) {
+        clear();
+        size_t n = std::distance(first, last);
+        if (n == 0) return;
+        size_t maxKeys = 2 * t - 1;
+        // 每个叶子连同其后的分隔 key 共占 per + 1 个，因此按 n + 1 分组
+        size_t per = bulkPerNode(fillFactor, t - 1, maxKeys);
+        size_t nLeaves = bulkGroupCount(n + 1, per + 1, t);
+        size_t leafKeys = n - (nLeaves - 1);
 
-// 简化：这里我们假设叶子节点存储 key（如有 value，可改为 pair）
-template<typename KeyType>
-class BPlusNode {
-public:
-    size_t t; // 最小度数或阶，根据需要定义；在内部节点最多 2t 子指针，叶子最多 2t keys
-    bool isLeaf;
-    std::deque<KeyType> keys;
-    BPlusNode* parent;
-    BPlusNode(size_t m, bool leaf) : t(m), isLeaf(leaf), parent(nullptr) {}
-    virtual ~BPlusNode() = default;
-    virtual void insert(KeyType) = 0;
-    virtual bool remove(const KeyType&) = 0;
-    virtual void traverse(int depth = 0) = 0;
+        std::vector<BTreeNode<KeyType, T>*> level;
+        std::vector<KeyType> seps;  // seps[i] 位于 level[i] 与 level[i+1] 之间
+        level.reserve(nLeaves);
+        seps.reserve(nLeaves);
+        for (size_t j = 0; j < nLeaves; ++j) {
+            size_t sz = leafKeys / nLeaves + (j < leafKeys % nLeaves ? 1 : 0);
+            BTreeNode<KeyType, T>* leaf = BTreeNode<KeyType, T>::create(&alloc, t, true);
+            for (size_t i = 0; i < sz; ++i, ++first)
+                leaf->keys.push_back(*first);
+            leaf->nKeys = static_cast<int>(sz);
+            level.push_back(leaf);
+            if (j + 1 < nLeaves) {
+                seps.push_back(*first);
+                ++first;
+            }
+        }
 
-    // 查找 key 在节点中的索引或应插入位置
-    int findKey(const KeyType& k) {
-        int idx = 0;
-        // 线性查找也可换二分：std::lower_bound
-        while (idx < keys.size() && keys[idx] < k)
-            ++idx;
-        return idx;
+        // 逐层向上：每个内部节点 [t, 2t] 个孩子，组内分隔 key 留在节点中，组间分隔 key 上移
+        size_t perChildren = bulkPerNode(fillFactor, t, 2 * t);
+        while (level.size() > 1) {
+            size_t m = level.size();
+            size_t nGroups = bulkGroupCount(m, perChildren, t);
+            std::vector<BTreeNode<KeyType, T>*> next;
+            std::vector<KeyType> nextSeps;
+            next.reserve(nGroups);
+            size_t c = 0;
+            for (size_t g = 0; g < nGroups; ++g) {
+                size_t cnt = m / nGroups + (g < m % nGroups ? 1 : 0);
+                BTreeNode<KeyType, T>* node = BTreeNode<KeyType, T>::create(&alloc, t, false);
+                for (size_t i = 0; i < cnt; ++i) {
+                    node->children.push_back(level[c + i]);
+                    if (i + 1 < cnt) node->keys.push_back(seps[c + i]);
+                }
+                node->nKeys = static_cast<int>(cnt - 1);
+                c += cnt;
+                if (g + 1 < nGroups) nextSeps.push_back(seps[c - 1]);
+                next.push_back(node);
+            }
+            level.swap(next);
+            seps.swap(nextSeps);
+        }
+        root = level[0];
+    }
+
+    // 释放所有节点；key 无需析构且分配器能整体回收时不遍历节点
+    void clear() {
+        if constexpr (Alloc::releasesAll && std::is_trivially_destructible<KeyType>::value)
+            alloc.release();
+        else
+            destroy(root);
+        root = nullptr;
+    }
+    // 统计快照：逐层遍历得到高度、各层节点数和填充分布，附带 BTREE_STATS 下的操作计数
+    TreeStats stats() const {
+        TreeStats s;
+        s.capacity = 2 * t - 1;
+        std::vector<const BTreeNode<KeyType, T>*> level, next;
+        if (root) level.push_back(root);
+        while (!level.empty()) {
+            s.nodesPerLevel.push_back(level.size());
+            next.clear();
+            for (auto node : level) {
+                s.keys += node->nKeys;
+                s.addNode(node->nKeys, BTreeNode<KeyType, T>::blockSize(t, node->isLeaf));
+                if (!node->isLeaf) {
+                    for (int i = 0; i <= node->nKeys; ++i)
+                        next.push_back(node->children[i]);
+                }
+            }
+            level.swap(next);
+        }
+        s.height = s.nodesPerLevel.size();
+#if BTREE_STATS
+        s.ops = opCounters;
+#endif
+        return s;
+    }
+
+    // 清零操作计数
+    void resetStats() {
+#if BTREE_STATS
+        opCounters = TreeOpCounters();
+#endif
+    }
+
+private:
+    using DegreeHolder<int, T>::t;
+    BTreeNode<KeyType, T>* root;
+    Alloc alloc;
+#if BTREE_STATS
+    TreeOpCounters opCounters;
+#endif
+
+    static void destroy(BTreeNode<KeyType, T>* node) {
+        if (!node) return;
+        if (!node->isLeaf) {
+            for (int i = 0; i <= node->nKeys; ++i)
+                destroy(node->children[i]);
+        }
+        node->dispose();
     }
 };
 
-template<typename KeyType>
-class BPlusLeafNode : public BPlusNode<KeyType> {
-public:
-    using BPlusNode<KeyType>::isLeaf;
-    using BPlusNode<KeyType>::keys;
-    using BPlusNode<KeyType>::t;
+// 最小度数在编译期给定的 B 树：节点不存 t，容量和节点大小都是常量
+template<typename KeyType, size_t T, typename Alloc = SlabArena>
+using FixedBTree = BTree<KeyType, Alloc, T>;
 
-    BPlusLeafNode* next;  // 叶子链表指针
-    BPlusLeafNode* prev;
-    // 存储 keys; 若需要存储 value，可改为 vector<pair<KeyType, ValueType>>
-    std::deque<KeyType> values;
-    BPlusLeafNode(size_t t) : BPlusNode<KeyType>(t, true), next(nullptr), prev(nullptr) {}
+// 节点不超过 Lines 条缓存行时的最大度数（至少为 2），如 FixedBTree<Key, btreeDegreeFor<Key>()>
+template<typename KeyType, size_t Lines = 8>
+constexpr size_t btreeDegreeFor() {
+    size_t t = 2;
+    // 内部节点比叶子大
+    while (BTreeNode<KeyType, 2>::blockSize(int(t + 1), false) <= Lines * cacheLineBytes) ++t;
+    return t;
+}
 
-    void insert(KeyType k) override {
-        auto it = std::lower_bound(keys.begin(), keys.end(), k);
-        keys.insert(it, k);
+// 有序数组 a[0..n) 中 < k 的元素个数，即 lower_bound 的下标
+// 通用版本：无分支二分，循环次数只与 n 有关，不会因比较结果分支预测失败
+template<typename T>
+inline size_t branchlessLowerBound(const T* a, size_t n, const T& k) {
+    if (n == 0) return 0;
+    const T* base = a;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = (base[half] < k) ? base + half : base;
+        n -= half;
     }
+    return (base - a) + (*base < k ? 1 : 0);
+}
 
-    bool remove(const KeyType& k) override {
-        size_t idx = this->findKey(k);
-        if (idx < keys.size() && keys[idx] == k) {
-            // key 在此节点, 叶子节点直接删除
-            keys.erase(keys.begin() + idx);
-            return true;
-        }
-        return false;
+#if defined(__SSE2__)
+// 32 位整数：一次比较一组 key，对 "a[i] < k" 的掩码做 popcount；
+// 节点内 key 有序，掩码不满时后面不会再有更小的 key，可以提前结束
+template<bool Unsigned>
+inline size_t simdCountLess32(const int32_t* a, size_t n, int32_t k) {
+    // 无符号数异或符号位后可以用有符号比较
+    const int32_t bias = Unsigned ? INT32_MIN : 0;
+    k ^= bias;
+    size_t i = 0, cnt = 0;
+#if defined(__AVX2__)
+    const __m256i kv8 = _mm256_set1_epi32(k);
+    const __m256i bv8 = _mm256_set1_epi32(bias);
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), bv8);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(kv8, v)));
+        cnt += __builtin_popcount(mask);
+        if (mask != 0xFF) return cnt;
+    }
+#endif
+    const __m128i kv = _mm_set1_epi32(k);
+    const __m128i bv = _mm_set1_epi32(bias);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), bv);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(kv, v)));
+        cnt += __builtin_popcount(mask);
+        if (mask != 0xF) return cnt;
+    }
+    for (; i < n; ++i) {
+        if ((a[i] ^ bias) >= k) return cnt;
+        ++cnt;
     }
+    return cnt;
+}
+#endif
 
-    // 遍历（调试用）
-    void traverse(int depth = 0) {
-        // 缩进
-        for (int i = 0; i < depth; ++i) std::cout << "  ";
-        std::cout << "[";
-        for (int i = 0; i < keys.size(); ++i) {
-            std::cout << keys[i];
-            if (i + 1 < keys.size()) std::cout << ", ";
+#if defined(__AVX2__) || defined(__SSE4_2__)
+// 64 位整数，做法同上（_mm_cmpgt_epi64 需要 SSE4.2）
+template<bool Unsigned>
+inline size_t simdCountLess64(const int64_t* a, size_t n, int64_t k) {
+    const int64_t bias = Unsigned ? INT64_MIN : 0;
+    k ^= bias;
+    size_t i = 0, cnt = 0;
+#if defined(__AVX2__)
+    const __m256i kv4 = _mm256_set1_epi64x(k);
+    const __m256i bv4 = _mm256_set1_epi64x(bias);
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), bv4);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(kv4, v)));
+        cnt += __builtin_popcount(mask);
+        if (mask != 0xF) return cnt;
+    }
+#endif
+    const __m128i kv = _mm_set1_epi64x(k);
+    const __m128i bv = _mm_set1_epi64x(bias);
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), bv);
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(kv, v)));
+        cnt += __builtin_popcount(mask);
+        if (mask != 0x3) return cnt;
+    }
+    for (; i < n; ++i) {
+        if ((a[i] ^ bias) >= k) return cnt;
+        ++cnt;
+    }
+    return cnt;
+}
+#endif
+
+// 节点内查找：32/64 位整数走 SIMD 比较 + popcount，其余类型走无分支二分
+template<typename T>
+inline size_t nodeLowerBound(const T* a, size_t n, const T& k) {
+#if defined(__SSE2__)
+    if constexpr (std::is_integral<T>::value && sizeof(T) == 4)
+        return simdCountLess32<std::is_unsigned<T>::value>(
+            reinterpret_cast<const int32_t*>(a), n, static_cast<int32_t>(k));
+#endif
+#if defined(__AVX2__) || defined(__SSE4_2__)
+    if constexpr (std::is_integral<T>::value && sizeof(T) == 8)
+        return simdCountLess64<std::is_unsigned<T>::value>(
+            reinterpret_cast<const int64_t*>(a), n, static_cast<int64_t>(k));
+#endif
+    return branchlessLowerBound(a, n, k);
+}
+
+// nodeLowerBound 对类型 T 是否走 SIMD
+template<typename T>
+constexpr bool nodeSearchUsesSimd() {
+    if (!std::is_integral<T>::value) return false;
+#if defined(__SSE2__)
+    if (sizeof(T) == 4) return true;
+#endif
+#if defined(__AVX2__) || defined(__SSE4_2__)
+    if (sizeof(T) == 8) return true;
+#endif
+    return false;
+}
+
+// 节点容量 Cap 在编译期已知：步长为 2 的幂、逐次减半的无分支二分，
+// 循环次数固定为 log2(Cap)+1，编译器完全展开；只读 a[0..n)。能走 SIMD 的整数仍用 nodeLowerBound
+template<size_t Cap, typename T>
+inline size_t fixedLowerBound(const T* a, size_t n, const T& k) {
+    if constexpr (nodeSearchUsesSimd<T>()) {
+        return nodeLowerBound(a, n, k);
+    }
+    else {
+        constexpr size_t top = [] {
+            size_t p = 1;
+            while (p * 2 <= Cap) p *= 2;
+            return p;
+        }();
+        size_t pos = 0;
+        for (size_t step = top; step > 0; step >>= 1) {
+            size_t probe = pos + step;
+            bool inside = probe <= n;
+            pos = (inside && a[inside ? probe - 1 : 0] < k) ? probe : pos;
         }
-        std::cout << "]";
-        std::cout << (isLeaf ? " (leaf)" : "") << "\n";
+        return pos;
     }
-};
+}
 
-template<typename KeyType>
-class BPlusInternalNode : public BPlusNode<KeyType> {
+// std::string key 的节点数组：节点内所有 key 的公共前缀只存一次，去掉前缀后的后缀
+// 首尾相接放在一块连续字节区里，字节区布局为 公共前缀 | 后缀 0 | 后缀 1 | ...。
+// 节点块内只放 ends 偏移数组，ends[i] 为第 i 个后缀在字节区中的结束位置。
+// 接口与 NodeArray 相同，但按值返回 key；key 须已按序排列（节点内总是如此）
+class PrefixKeyArray {
 public:
-    using BPlusNode<KeyType>::isLeaf;
-    using BPlusNode<KeyType>::keys;
-    using BPlusNode<KeyType>::t;
+    using slot_type = uint32_t;
+    using const_reference = std::string;
 
-    std::deque<BPlusNode<KeyType>*> children;
-    BPlusInternalNode(size_t t) : BPlusNode<KeyType>(t, false) {}
+    // 按下标随机访问的只读迭代器，解引用得到 key 的拷贝
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string;
 
-    void insert(KeyType k) override {
-        size_t idx = this->findKey(k);
-        bool insertMax = (idx == keys.size());
-        if (insertMax) --idx;
-        children[idx]->insert(k);
-        if (insertMax) keys.at(idx) = k;
-        if (children[idx]->keys.size() > 2 * t) {
-            splitChild(idx);
+        iterator() : arr(nullptr), i(0) {}
+        iterator(const PrefixKeyArray* _arr, size_t _i) : arr(_arr), i(_i) {}
+        std::string operator*() const { return (*arr)[i]; }
+        std::string operator[](difference_type d) const { return (*arr)[i + d]; }
+        iterator& operator++() { ++i; return *this; }
+        iterator operator++(int) { iterator tmp = *this; ++i; return tmp; }
+        iterator& operator--() { --i; return *this; }
+        iterator operator--(int) { iterator tmp = *this; --i; return tmp; }
+        iterator& operator+=(difference_type d) { i += d; return *this; }
+        iterator& operator-=(difference_type d) { i -= d; return *this; }
+        iterator operator+(difference_type d) const { return iterator(arr, i + d); }
+        iterator operator-(difference_type d) const { return iterator(arr, i - d); }
+        difference_type operator-(const iterator& o) const { return difference_type(i) - difference_type(o.i); }
+        bool operator==(const iterator& o) const { return i == o.i; }
+        bool operator!=(const iterator& o) const { return i != o.i; }
+        bool operator<(const iterator& o) const { return i < o.i; }
+        bool operator>(const iterator& o) const { return i > o.i; }
+        bool operator<=(const iterator& o) const { return i <= o.i; }
+        bool operator>=(const iterator& o) const { return i >= o.i; }
+        size_t index() const { return i; }
+    private:
+        const PrefixKeyArray* arr;
+        size_t i;
+    };
+
+    PrefixKeyArray(uint32_t* storage, size_t capacity)
+        : ends(storage), n(0), cap(capacity), bytes(nullptr), used(0), byteCap(0), prefixLen(0) {}
+    ~PrefixKeyArray() { std::free(bytes); }
+    PrefixKeyArray(const PrefixKeyArray&) = delete;
+    PrefixKeyArray& operator=(const PrefixKeyArray&) = delete;
+
+    size_t size() const { return n; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return n == 0; }
+    // 公共前缀长度和全部 key 占用的字节数（含前缀），用于统计压缩效果
+    size_t prefixLength() const { return prefixLen; }
+    size_t byteSize() const { return used; }
+
+    std::string operator[](size_t i) const {
+        std::string key;
+        key.reserve(prefixLen + suffixLen(i));
+        key.append(bytes, prefixLen);
+        key.append(bytes + suffixStart(i), suffixLen(i));
+        return key;
+    }
+    std::string front() const { return (*this)[0]; }
+    std::string back() const { return (*this)[n - 1]; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, n); }
+
+    // [from, n) 中第一个 >= k 的下标：先整体比较公共前缀，再只在后缀上二分，不构造 std::string
+    size_t lowerBound(const std::string& k, size_t from = 0) const {
+        if (from >= n) return n;
+        int c = std::memcmp(k.data(), bytes, std::min(k.size(), prefixLen));
+        if (c < 0 || (c == 0 && k.size() < prefixLen)) return from;
+        if (c > 0) return n;
+        const char* rest = k.data() + prefixLen;
+        size_t restLen = k.size() - prefixLen;
+        size_t lo = from, hi = n;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (compareSuffix(mid, rest, restLen) < 0) lo = mid + 1;
+            else hi = mid;
         }
+        return lo;
     }
 
-    void splitChild(size_t idx) {
-        BPlusNode<KeyType>* left = children[idx];
-        int num = left->keys.size();
-        int midIndex = num / 2;
+    bool equals(size_t i, const std::string& k) const {
+        return k.size() == prefixLen + suffixLen(i)
+            && std::memcmp(k.data(), bytes, prefixLen) == 0
+            && std::memcmp(k.data() + prefixLen, bytes + suffixStart(i), suffixLen(i)) == 0;
+    }
 
-        // 创建新内部节点
-        BPlusNode<KeyType>* right = nullptr;
-        if (left->isLeaf) {
-            BPlusLeafNode<KeyType> *newNode = new BPlusLeafNode<KeyType>(t);
-            right = newNode;
-            BPlusLeafNode<KeyType>* leftNode = static_cast<BPlusLeafNode<KeyType>*>(left);
-            // 插入到链表
-            newNode->next = leftNode->next;
-            if (leftNode->next) leftNode->next->prev = newNode;
-            leftNode->next = newNode;
-            newNode->prev = leftNode;
+    void set(size_t i, const std::string& k) {
+        eraseAt(i, false);
+        insertAt(i, k);
+    }
+    iterator insert(iterator pos, const std::string& k) {
+        insertAt(pos.index(), k);
+        return pos;
+    }
+    template<typename It>
+    iterator insert(iterator pos, It first, It last) {
+        std::vector<std::string> all(begin(), end());
+        all.insert(all.begin() + pos.index(), first, last);
+        rebuild(all);
+        return pos;
+    }
+    iterator erase(iterator pos) {
+        eraseAt(pos.index(), true);
+        return pos;
+    }
+    void push_back(const std::string& k) { insertAt(n, k); }
+    void pop_back() { eraseAt(n - 1, true); }
+    void pop_front() { eraseAt(0, true); }
+    void clear() {
+        n = 0;
+        used = 0;
+        prefixLen = 0;
+    }
+    // 只用于截短
+    void resize(size_t m) {
+        if (m >= n) return;
+        if (m == 0) {
+            clear();
+            return;
         }
-        else {
-            BPlusInternalNode<KeyType> *newNode = new BPlusInternalNode<KeyType>(t);
-            right = newNode;
-            // 右半部分 children 和 keys 移动到 right
-            BPlusInternalNode<KeyType>* leftNode = static_cast<BPlusInternalNode<KeyType>*>(left);
-            // children 从 midIndex 开始移
-            newNode->children.assign(leftNode->children.begin() + midIndex, leftNode->children.end());
-            // 更新 parent 指针
-            for (auto child : newNode->children) {
-                child->parent = newNode;
-            }
-            leftNode->children.resize(midIndex);
+        used = ends[m - 1];
+        n = m;
+        extendPrefix();
+    }
+    template<typename It>
+    void assign(It first, It last) {
+        std::vector<std::string> all(first, last);
+        rebuild(all);
+    }
+
+private:
+    uint32_t* ends;
+    size_t n, cap;
+    char* bytes;
+    size_t used, byteCap;
+    size_t prefixLen;
+
+    size_t suffixStart(size_t i) const { return i ? ends[i - 1] : prefixLen; }
+    size_t suffixLen(size_t i) const { return ends[i] - suffixStart(i); }
+
+    int compareSuffix(size_t i, const char* k, size_t kLen) const {
+        size_t len = suffixLen(i);
+        int c = std::memcmp(bytes + suffixStart(i), k, std::min(len, kLen));
+        if (c != 0) return c;
+        return len < kLen ? -1 : (len > kLen ? 1 : 0);
+    }
+
+    void reserveBytes(size_t need) {
+        if (need <= byteCap && bytes) return;
+        size_t newCap = std::max<size_t>({ need, byteCap * 2, 64 });
+        char* p = static_cast<char*>(std::realloc(bytes, newCap));
+        if (!p) throw std::bad_alloc();
+        bytes = p;
+        byteCap = newCap;
+    }
+
+    void insertAt(size_t i, const std::string& k) {
+        if (n == 0) {
+            // 只有一个 key 时整个 key 都是前缀
+            reserveBytes(k.size());
+            std::memcpy(bytes, k.data(), k.size());
+            prefixLen = used = k.size();
+            ends[0] = static_cast<uint32_t>(used);
+            n = 1;
+            return;
         }
+        size_t common = 0;
+        size_t m = std::min(k.size(), prefixLen);
+        while (common < m && k[common] == bytes[common]) ++common;
+        if (common < prefixLen) shrinkPrefix(common);
+        size_t len = k.size() - prefixLen;
+        reserveBytes(used + len);
+        size_t at = suffixStart(i);
+        std::memmove(bytes + at + len, bytes + at, used - at);
+        std::memcpy(bytes + at, k.data() + prefixLen, len);
+        for (size_t j = n; j > i; --j) ends[j] = static_cast<uint32_t>(ends[j - 1] + len);
+        ends[i] = static_cast<uint32_t>(at + len);
+        used += len;
+        ++n;
+    }
 
-        // keys 从 midIndex 开始移（keys 数 = children.size()-1）
-        right->keys.assign(left->keys.begin() + midIndex, left->keys.end());
+    // extend 为 true 时删除后尝试加长公共前缀
+    void eraseAt(size_t i, bool extend) {
+        size_t at = suffixStart(i), len = suffixLen(i);
+        std::memmove(bytes + at, bytes + at + len, used - at - len);
+        for (size_t j = i; j + 1 < n; ++j) ends[j] = static_cast<uint32_t>(ends[j + 1] - len);
+        used -= len;
+        --n;
+        if (n == 0) clear();
+        else if (extend) extendPrefix();
+    }
 
-        // 剪裁原 left
-        left->keys.resize(midIndex);
-        // 将 upKey 插入到父节点
-        right->parent = left->parent;
-        keys[idx] = left->keys.back();
-        keys.insert(keys.begin() + idx + 1, right->keys.back());
-        children.insert(children.begin() + idx + 1, right);
+    // 新 key 与前缀只有前 len 个字节相同：把前缀多出的部分挪回每个后缀开头
+    void shrinkPrefix(size_t len) {
+        size_t d = prefixLen - len;
+        size_t newUsed = used + (n - 1) * d;
+        size_t newCap = std::max<size_t>(newUsed, 64);
+        char* p = static_cast<char*>(std::malloc(newCap));
+        if (!p) throw std::bad_alloc();
+        std::memcpy(p, bytes, len);
+        size_t at = len, oldEnd = prefixLen;
+        for (size_t i = 0; i < n; ++i) {
+            size_t sl = ends[i] - oldEnd;
+            std::memcpy(p + at, bytes + len, d);
+            std::memcpy(p + at + d, bytes + oldEnd, sl);
+            oldEnd = ends[i];
+            at += d + sl;
+            ends[i] = static_cast<uint32_t>(at);
+        }
+        std::free(bytes);
+        bytes = p;
+        byteCap = newCap;
+        used = newUsed;
+        prefixLen = len;
     }
 
-    // 删除 key 的公共接口
-    bool remove(const KeyType& k) override {
-        size_t idx = this->findKey(k);
-        if (idx == keys.size()) return false;
-        if (!children[idx]->remove(k)) return false;
-        keys.at(idx) = children[idx]->keys.back();
-        if (children[idx]->keys.size() < t) {
-            fill(idx);
+    // 删除或截短后，剩余 key 的公共前缀可能变长
+    void extendPrefix() {
+        size_t ext = suffixLen(0);
+        for (size_t i = 1; i < n && ext > 0; ++i) {
+            const char* a = bytes + suffixStart(0);
+            const char* b = bytes + suffixStart(i);
+            size_t m = std::min(ext, suffixLen(i)), c = 0;
+            while (c < m && a[c] == b[c]) ++c;
+            ext = c;
         }
-        return true;
+        if (ext == 0) return;
+        // 前缀后面紧跟的就是后缀 0，前缀直接延长 ext，后缀 0 的结束位置不变；
+        // 其余后缀各去掉开头 ext 个字节并前移
+        size_t w = ends[0], oldEnd = ends[0];
+        for (size_t i = 1; i < n; ++i) {
+            size_t from = oldEnd + ext, len = ends[i] - from;
+            std::memmove(bytes + w, bytes + from, len);
+            oldEnd = ends[i];
+            w += len;
+            ends[i] = static_cast<uint32_t>(w);
+        }
+        used = w;
+        prefixLen += ext;
     }
 
-    // fill children[idx] 使其至少有 t 个关键字
-    void fill(size_t idx) {
-        BPlusNode<KeyType>* cur = children[idx];
-        // 如果前兄弟有多余，借
-        if (idx > 0 && children[idx-1]->keys.size() > t) {
-            borrowFromPrev(idx);
+    void rebuild(const std::vector<std::string>& all) {
+        clear();
+        if (all.empty()) return;
+        size_t common = all.front().size();
+        for (const std::string& k : all) {
+            size_t m = std::min(common, k.size()), c = 0;
+            while (c < m && k[c] == all.front()[c]) ++c;
+            common = c;
         }
-        // 后兄弟有多余，借
-        else if ((idx + 1) < keys.size() && children[idx + 1]->keys.size() > t) {
-            borrowFromNext(idx);
+        size_t total = common;
+        for (const std::string& k : all) total += k.size() - common;
+        reserveBytes(total);
+        std::memcpy(bytes, all.front().data(), common);
+        used = prefixLen = common;
+        for (const std::string& k : all) {
+            std::memcpy(bytes + used, k.data() + common, k.size() - common);
+            used += k.size() - common;
+            ends[n++] = static_cast<uint32_t>(used);
         }
-        else {
-            // 合并
-            if (idx > 0) {
-                mergePrev(idx);
+    }
+};
+
+// 整数 key 的包装类型：BPlusTree<PackedInt<int64_t>> 的节点用 PackedKeyArray 存 key。
+// 可隐式与 Int 互转，比较、输出都按 Int 进行
+template<typename Int>
+struct PackedInt {
+    static_assert(std::is_integral<Int>::value, "PackedInt wraps an integer type");
+    Int v;
+    PackedInt() : v() {}
+    PackedInt(Int x) : v(x) {}
+    operator Int() const { return v; }
+};
+
+// 有序 uint16_t 数组 a[0..n) 中 < k 的元素个数，做法同 simdCountLess32，一次比较 8/16 个
+inline size_t countLess16(const uint16_t* a, size_t n, uint16_t k) {
+    size_t i = 0, cnt = 0;
+#if defined(__SSE2__)
+    // 异或 0x8000 后用有符号比较；movemask_epi8 每个 16 位元素占两位
+    const int16_t kb = static_cast<int16_t>(k ^ 0x8000);
+#if defined(__AVX2__)
+    const __m256i kv16 = _mm256_set1_epi16(kb);
+    const __m256i bv16 = _mm256_set1_epi16(INT16_MIN);
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), bv16);
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpgt_epi16(kv16, v)));
+        cnt += __builtin_popcount(mask) / 2;
+        if (mask != 0xFFFFFFFFu) return cnt;
+    }
+#endif
+    const __m128i kv = _mm_set1_epi16(kb);
+    const __m128i bv = _mm_set1_epi16(INT16_MIN);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), bv);
+        int mask = _mm_movemask_epi8(_mm_cmpgt_epi16(kv, v));
+        cnt += __builtin_popcount(mask) / 2;
+        if (mask != 0xFFFF) return cnt;
+    }
+#endif
+    for (; i < n; ++i) {
+        if (a[i] >= k) return cnt;
+        ++cnt;
+    }
+    return cnt;
+}
+
+// 整数 key 的帧参考（frame of reference）节点数组：base 取最小 key，节点块内只放
+// 16 位差值 lanes[i] = keys[i] - base，key 占用降为 2 字节。节点内 key 跨度超过 65535 时
+// 改为在堆上存完整 key（wide），跨度回落后再压缩回去。查找直接在差值上做 SIMD 比较，不解码。
+// 接口与 PrefixKeyArray 相同，按值返回 key；key 须已按序排列
+template<typename Int>
+class PackedKeyArray {
+    using U = typename std::make_unsigned<Int>::type;
+    static constexpr U maxDelta = 0xFFFF;
+public:
+    using slot_type = uint16_t;
+    using const_reference = PackedInt<Int>;
+
+    // 按下标随机访问的只读迭代器，解引用得到 key 的拷贝
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = PackedInt<Int>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = PackedInt<Int>;
+
+        iterator() : arr(nullptr), i(0) {}
+        iterator(const PackedKeyArray* _arr, size_t _i) : arr(_arr), i(_i) {}
+        PackedInt<Int> operator*() const { return (*arr)[i]; }
+        PackedInt<Int> operator[](difference_type d) const { return (*arr)[i + d]; }
+        iterator& operator++() { ++i; return *this; }
+        iterator operator++(int) { iterator tmp = *this; ++i; return tmp; }
+        iterator& operator--() { --i; return *this; }
+        iterator operator--(int) { iterator tmp = *this; --i; return tmp; }
+        iterator& operator+=(difference_type d) { i += d; return *this; }
+        iterator& operator-=(difference_type d) { i -= d; return *this; }
+        iterator operator+(difference_type d) const { return iterator(arr, i + d); }
+        iterator operator-(difference_type d) const { return iterator(arr, i - d); }
+        difference_type operator-(const iterator& o) const { return difference_type(i) - difference_type(o.i); }
+        bool operator==(const iterator& o) const { return i == o.i; }
+        bool operator!=(const iterator& o) const { return i != o.i; }
+        bool operator<(const iterator& o) const { return i < o.i; }
+        bool operator>(const iterator& o) const { return i > o.i; }
+        bool operator<=(const iterator& o) const { return i <= o.i; }
+        bool operator>=(const iterator& o) const { return i >= o.i; }
+        size_t index() const { return i; }
+    private:
+        const PackedKeyArray* arr;
+        size_t i;
+    };
+
+    PackedKeyArray(uint16_t* storage, size_t capacity)
+        : lanes(storage), wide(nullptr), n(0), cap(capacity), base() {}
+    ~PackedKeyArray() { std::free(wide); }
+    PackedKeyArray(const PackedKeyArray&) = delete;
+    PackedKeyArray& operator=(const PackedKeyArray&) = delete;
+
+    size_t size() const { return n; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return n == 0; }
+    // 是否为压缩格式，以及 key 实际占用的字节数，用于统计压缩效果
+    bool packed() const { return !wide; }
+    size_t byteSize() const { return wide ? cap * sizeof(Int) : n * sizeof(uint16_t); }
+
+    PackedInt<Int> operator[](size_t i) const { return at(i); }
+    PackedInt<Int> front() const { return at(0); }
+    PackedInt<Int> back() const { return at(n - 1); }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, n); }
+
+    // [from, n) 中第一个 >= k 的下标：k 换算成相对 base 的差值后直接在 lanes 上比较
+    size_t lowerBound(Int k, size_t from = 0) const {
+        if (from >= n) return n;
+        if (wide) return from + nodeLowerBound(wide + from, n - from, k);
+        if (k <= base) return from;
+        U d = delta(base, k);
+        if (d > maxDelta) return n;
+        return from + countLess16(lanes + from, n - from, static_cast<uint16_t>(d));
+    }
+
+    bool equals(size_t i, Int k) const { return at(i) == k; }
+
+    void set(size_t i, Int k) {
+        // 不改变首尾时跨度不变，原地覆盖
+        if (i > 0 && i + 1 < n) {
+            if (wide) wide[i] = k;
+            else lanes[i] = static_cast<uint16_t>(delta(base, k));
+            return;
+        }
+        eraseAt(i);
+        insertAt(i, k);
+    }
+    iterator insert(iterator pos, Int k) {
+        insertAt(pos.index(), k);
+        return pos;
+    }
+    template<typename It>
+    iterator insert(iterator pos, It first, It last) {
+        std::vector<Int> all(begin(), end());
+        all.insert(all.begin() + pos.index(), first, last);
+        assign(all.begin(), all.end());
+        return pos;
+    }
+    iterator erase(iterator pos) {
+        eraseAt(pos.index());
+        return pos;
+    }
+    void push_back(Int k) { insertAt(n, k); }
+    void pop_back() { eraseAt(n - 1); }
+    void pop_front() { eraseAt(0); }
+    void clear() {
+        n = 0;
+        std::free(wide);
+        wide = nullptr;
+    }
+    // 只用于截短
+    void resize(size_t m) {
+        if (m >= n) return;
+        if (m == 0) {
+            clear();
+            return;
+        }
+        n = m;
+        if (wide && delta(wide[0], wide[n - 1]) <= maxDelta) unspill();
+    }
+    template<typename It>
+    void assign(It first, It last) {
+        clear();
+        if (first == last) return;
+        Int lo = *first, hi = *std::prev(last);
+        if (delta(lo, hi) <= maxDelta) {
+            base = lo;
+            for (; first != last; ++first) lanes[n++] = static_cast<uint16_t>(delta(base, *first));
+        }
+        else {
+            wide = allocWide();
+            for (; first != last; ++first) wide[n++] = *first;
+        }
+    }
+
+private:
+    uint16_t* lanes;  // 节点块内的差值
+    Int* wide;        // 跨度过大时的完整 key，此时 lanes 不用
+    size_t n, cap;
+    Int base;         // 压缩格式下等于 keys[0]
+
+    static U delta(Int lo, Int hi) { return static_cast<U>(static_cast<U>(hi) - static_cast<U>(lo)); }
+    Int at(size_t i) const { return wide ? wide[i] : static_cast<Int>(static_cast<U>(base) + lanes[i]); }
+
+    Int* allocWide() const {
+        Int* p = static_cast<Int*>(std::malloc(cap * sizeof(Int)));
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+    // 压缩格式 -> 完整 key
+    void spill() {
+        Int* p = allocWide();
+        for (size_t j = 0; j < n; ++j) p[j] = at(j);
+        wide = p;
+    }
+    // 完整 key -> 压缩格式，调用前须确认跨度不超过 maxDelta
+    void unspill() {
+        base = wide[0];
+        for (size_t j = 0; j < n; ++j) lanes[j] = static_cast<uint16_t>(delta(base, wide[j]));
+        std::free(wide);
+        wide = nullptr;
+    }
+    // base 改为 b（b 不大于所有 key）：所有差值同加一个数，按 16 位取模即可
+    void rebase(Int b) {
+        uint16_t d = static_cast<uint16_t>(delta(b, base));
+        for (size_t j = 0; j < n; ++j) lanes[j] = static_cast<uint16_t>(lanes[j] + d);
+        base = b;
+    }
+
+    void insertAt(size_t i, Int k) {
+        if (n == 0) {
+            base = k;
+            lanes[0] = 0;
+            n = 1;
+            return;
+        }
+        if (!wide) {
+            // 插入只会扩大跨度
+            Int lo = i == 0 ? k : base, hi = i == n ? k : at(n - 1);
+            if (delta(lo, hi) > maxDelta) spill();
+            else if (i == 0) rebase(k);
+        }
+        if (wide) {
+            std::memmove(wide + i + 1, wide + i, (n - i) * sizeof(Int));
+            wide[i] = k;
+        }
+        else {
+            std::memmove(lanes + i + 1, lanes + i, (n - i) * sizeof(uint16_t));
+            lanes[i] = static_cast<uint16_t>(delta(base, k));
+        }
+        ++n;
+    }
+
+    void eraseAt(size_t i) {
+        if (n == 1) {
+            clear();
+            return;
+        }
+        if (wide) {
+            std::memmove(wide + i, wide + i + 1, (n - i - 1) * sizeof(Int));
+            --n;
+            // 删掉首尾后跨度可能回落
+            if ((i == 0 || i == n) && delta(wide[0], wide[n - 1]) <= maxDelta) unspill();
+            return;
+        }
+        std::memmove(lanes + i, lanes + i + 1, (n - i - 1) * sizeof(uint16_t));
+        --n;
+        if (i == 0) rebase(at(0));
+    }
+};
+
+// B+ 树节点存 key 的数组：一般类型用 NodeArray，std::string 用前缀压缩的 PrefixKeyArray，
+// PackedInt 用差值压缩的 PackedKeyArray
+template<typename KeyType>
+struct BPlusKeyArraySelect { using type = NodeArray<KeyType>; };
+template<>
+struct BPlusKeyArraySelect<std::string> { using type = PrefixKeyArray; };
+template<typename Int>
+struct BPlusKeyArraySelect<PackedInt<Int>> { using type = PackedKeyArray<Int>; };
+template<typename KeyType>
+using BPlusKeyArray = typename BPlusKeyArraySelect<KeyType>::type;
+
+// 节点内 [from, size) 中第一个 >= k 的下标
+template<typename T>
+inline size_t bplusLowerBound(const NodeArray<T>& keys, const T& k, size_t from = 0) {
+    return from + nodeLowerBound(keys.data() + from, keys.size() - from, k);
+}
+inline size_t bplusLowerBound(const PrefixKeyArray& keys, const std::string& k, size_t from = 0) {
+    return keys.lowerBound(k, from);
+}
+template<typename Int>
+inline size_t bplusLowerBound(const PackedKeyArray<Int>& keys, const PackedInt<Int>& k, size_t from = 0) {
+    return keys.lowerBound(k, from);
+}
+
+template<typename T>
+inline bool bplusKeyEquals(const NodeArray<T>& keys, size_t i, const T& k) { return keys[i] == k; }
+inline bool bplusKeyEquals(const PrefixKeyArray& keys, size_t i, const std::string& k) { return keys.equals(i, k); }
+template<typename Int>
+inline bool bplusKeyEquals(const PackedKeyArray<Int>& keys, size_t i, const PackedInt<Int>& k) { return keys.equals(i, k); }
+
+// key 数组在节点块之外占用的堆内存字节数
+template<typename T>
+inline size_t bplusKeyHeapBytes(const NodeArray<T>&) { return 0; }
+inline size_t bplusKeyHeapBytes(const PrefixKeyArray& keys) { return keys.byteSize(); }
+template<typename Int>
+inline size_t bplusKeyHeapBytes(const PackedKeyArray<Int>& keys) { return keys.packed() ? 0 : keys.byteSize(); }
+
+// 叶子分裂后内部节点的分隔 key：任取 [left, right) 中的值都能正确路由，取其中最短的。
+// 一般类型直接用左半最大 key；字符串取 left 去掉公共前缀之后第一个字节加一的最短前缀
+template<typename T>
+inline T bplusSeparator(const T& left, const T&) { return left; }
+inline std::string bplusSeparator(const std::string& left, const std::string& right) {
+    size_t m = std::min(left.size(), right.size()), c = 0;
+    while (c < m && left[c] == right[c]) ++c;
+    if (c == left.size()) return left;
+    std::string sep = left.substr(0, c + 1);
+    sep[c] = static_cast<char>(static_cast<unsigned char>(sep[c]) + 1);
+    return sep < right ? sep : left;
+}
+
+// 只存 key 时的 value 占位类型，此时叶子不为 value 分配空间
+struct BPlusNoValue {};
+
+// 叶子插入方式：Duplicate 允许重复 key（原 insert 行为），
+// Assign 已存在时覆盖 value，KeepExisting 已存在时保持原 value
+enum class BPlusInsertMode { Duplicate, Assign, KeepExisting };
+
+// 叶子节点存储 key，ValueType 不为 BPlusNoValue 时在 key 旁另存一份 value（SoA）
+template<typename KeyType, typename ValueType, size_t T = 0>
+class BPlusNode : public DegreeHolder<size_t, T> {
+    static_assert(alignof(KeyType) <= alignof(std::max_align_t), "node blocks are max_align_t aligned");
+    static_assert(alignof(ValueType) <= alignof(std::max_align_t), "node blocks are max_align_t aligned");
+public:
+    using DegreeHolder<size_t, T>::t; // 最小度数；在内部节点最多 2t 子指针，叶子最多 2t keys
+    bool isLeaf;
+    using KeyArray = BPlusKeyArray<KeyType>;
+    using KeySlot = typename KeyArray::slot_type;
+    // 插入后、分裂前最多会暂时有 2t+1 个 key
+    KeyArray keys;
+    BPlusNode* parent;
+    NodeAllocator* alloc;  // 分配本节点的分配器
+    BPlusNode(NodeAllocator* a, size_t m, bool leaf, KeySlot* keyBuf)
+        : DegreeHolder<size_t, T>(m), isLeaf(leaf), keys(keyBuf, 2 * m + 1), parent(nullptr), alloc(a) {}
+    virtual ~BPlusNode() = default;
+    BPlusNode(const BPlusNode&) = delete;
+    BPlusNode& operator=(const BPlusNode&) = delete;
+
+    // 析构并把整块内存还给分配器
+    void dispose() {
+        NodeAllocator* a = alloc;
+        size_t bytes = blockSize();
+        this->~BPlusNode();
+        a->deallocate(this, bytes);
+    }
+    virtual size_t blockSize() const = 0;
+    // 返回是否新插入了 key（Assign/KeepExisting 下 key 已存在时为 false）
+    virtual bool insert(KeyType k, ValueType&& v, BPlusInsertMode mode) = 0;
+    virtual bool remove(const KeyType&) = 0;
+    virtual void traverse(int depth = 0) = 0;
+
+    // 查找 key 在节点中的索引或应插入位置
+    size_t findKey(const KeyType& k) const {
+        BTREE_COUNT(nodeVisits);
+        if constexpr (T != 0 && std::is_same<KeyArray, NodeArray<KeyType>>::value)
+            return fixedLowerBound<2 * T + 1>(keys.data(), keys.size(), k);
+        return bplusLowerBound(keys, k);
+    }
+    bool keyEquals(size_t i, const KeyType& k) const {
+        return bplusKeyEquals(keys, i, k);
+    }
+};
+
+template<typename KeyType, typename ValueType, size_t T = 0>
+class BPlusLeafNode : public BPlusNode<KeyType, ValueType, T> {
+public:
+    using BPlusNode<KeyType, ValueType, T>::isLeaf;
+    using BPlusNode<KeyType, ValueType, T>::keys;
+    using BPlusNode<KeyType, ValueType, T>::t;
+    using KeySlot = typename BPlusNode<KeyType, ValueType, T>::KeySlot;
+
+    static constexpr bool hasValue = !std::is_same<ValueType, BPlusNoValue>::value;
+
+    BPlusLeafNode* next;  // 叶子链表指针
+    BPlusLeafNode* prev;
+    // values[i] 对应 keys[i]；只存 key 时容量为 0
+    NodeArray<ValueType> values;
+
+    // 一块内存：节点 | keys[2t+1] | values[2t+1]
+    static BPlusLeafNode* create(NodeAllocator* a, size_t t) {
+        char* p = static_cast<char*>(a->allocate(bytesFor(t)));
+        return new (p) BPlusLeafNode(a, t, reinterpret_cast<KeySlot*>(p + keysOffset()),
+                                     reinterpret_cast<ValueType*>(p + valuesOffset(t)));
+    }
+    static constexpr size_t keysOffset() { return nodeAlignUp(sizeof(BPlusLeafNode), alignof(KeySlot)); }
+    static constexpr size_t valuesOffset(size_t t) {
+        return nodeAlignUp(keysOffset() + (2 * t + 1) * sizeof(KeySlot), alignof(ValueType));
+    }
+    // 编译期度数的节点补齐到整数条缓存行
+    static constexpr size_t bytesFor(size_t t) {
+        size_t bytes = hasValue ? valuesOffset(t) + (2 * t + 1) * sizeof(ValueType)
+                                : keysOffset() + (2 * t + 1) * sizeof(KeySlot);
+        return T ? nodeAlignUp(bytes, cacheLineBytes) : bytes;
+    }
+    size_t blockSize() const override { return bytesFor(t); }
+
+    BPlusLeafNode(NodeAllocator* a, size_t t, KeySlot* keyBuf, ValueType* valueBuf)
+        : BPlusNode<KeyType, ValueType, T>(a, t, true, keyBuf), next(nullptr), prev(nullptr),
+          values(valueBuf, hasValue ? 2 * t + 1 : 0) {}
+
+    bool insert(KeyType k, ValueType&& v, BPlusInsertMode mode) override {
+        size_t idx = this->findKey(k);
+        if (mode != BPlusInsertMode::Duplicate && idx < keys.size() && this->keyEquals(idx, k)) {
+            if constexpr (hasValue) {
+                if (mode == BPlusInsertMode::Assign) values[idx] = std::move(v);
+            }
+            return false;
+        }
+        keys.insert(keys.begin() + idx, std::move(k));
+        if constexpr (hasValue) values.insert(values.begin() + idx, std::move(v));
+        return true;
+    }
+
+    bool remove(const KeyType& k) override {
+        size_t idx = this->findKey(k);
+        if (idx < keys.size() && this->keyEquals(idx, k)) {
+            // key 在此节点, 叶子节点直接删除
+            keys.erase(keys.begin() + idx);
+            if constexpr (hasValue) values.erase(values.begin() + idx);
+            return true;
+        }
+        return false;
+    }
+
+    // 遍历（调试用）
+    void traverse(int depth = 0) {
+        // 缩进
+        for (int i = 0; i < depth; ++i) std::cout << "  ";
+        std::cout << "[";
+        for (int i = 0; i < keys.size(); ++i) {
+            std::cout << keys[i];
+            if (i + 1 < keys.size()) std::cout << ", ";
+        }
+        std::cout << "]";
+        std::cout << (isLeaf ? " (leaf)" : "") << "\n";
+    }
+};
+
+template<typename KeyType, typename ValueType, size_t T = 0>
+class BPlusInternalNode : public BPlusNode<KeyType, ValueType, T> {
+public:
+    using BPlusNode<KeyType, ValueType, T>::isLeaf;
+    using BPlusNode<KeyType, ValueType, T>::keys;
+    using BPlusNode<KeyType, ValueType, T>::t;
+
+    using KeySlot = typename BPlusNode<KeyType, ValueType, T>::KeySlot;
+
+    // children 与 keys 分开存放，keys[i] 不小于 children[i] 子树的最大 key，且小于 children[i+1] 中的 key
+    NodeArray<BPlusNode<KeyType, ValueType, T>*> children;
+    // counts[i] 为 children[i] 子树中的元素个数，用于按序号定位（select / rank）
+    NodeArray<size_t> counts;
+
+    // 一块内存：节点 | keys[2t+1] | children[2t+1] | counts[2t+1]
+    static BPlusInternalNode* create(NodeAllocator* a, size_t t) {
+        char* p = static_cast<char*>(a->allocate(bytesFor(t)));
+        return new (p) BPlusInternalNode(a, t, reinterpret_cast<KeySlot*>(p + keysOffset()),
+                                         reinterpret_cast<BPlusNode<KeyType, ValueType, T>**>(p + childrenOffset(t)),
+                                         reinterpret_cast<size_t*>(p + countsOffset(t)));
+    }
+    static constexpr size_t keysOffset() { return nodeAlignUp(sizeof(BPlusInternalNode), alignof(KeySlot)); }
+    static constexpr size_t childrenOffset(size_t t) {
+        return nodeAlignUp(keysOffset() + (2 * t + 1) * sizeof(KeySlot), alignof(BPlusNode<KeyType, ValueType, T>*));
+    }
+    static constexpr size_t countsOffset(size_t t) {
+        return nodeAlignUp(childrenOffset(t) + (2 * t + 1) * sizeof(BPlusNode<KeyType, ValueType, T>*), alignof(size_t));
+    }
+    static constexpr size_t bytesFor(size_t t) {
+        size_t bytes = countsOffset(t) + (2 * t + 1) * sizeof(size_t);
+        return T ? nodeAlignUp(bytes, cacheLineBytes) : bytes;
+    }
+    size_t blockSize() const override { return bytesFor(t); }
+
+    BPlusInternalNode(NodeAllocator* a, size_t t, KeySlot* keyBuf, BPlusNode<KeyType, ValueType, T>** childBuf,
+                      size_t* countBuf)
+        : BPlusNode<KeyType, ValueType, T>(a, t, false, keyBuf), children(childBuf, 2 * t + 1),
+          counts(countBuf, 2 * t + 1) {}
+
+    // node 子树中的元素个数
+    static size_t subtreeCount(const BPlusNode<KeyType, ValueType, T>* node) {
+        if (node->isLeaf) return node->keys.size();
+        auto& c = static_cast<const BPlusInternalNode*>(node)->counts;
+        return std::accumulate(c.begin(), c.end(), size_t(0));
+    }
+
+    bool insert(KeyType k, ValueType&& v, BPlusInsertMode mode) override {
+        size_t idx = this->findKey(k);
+        bool insertMax = (idx == keys.size());
+        if (insertMax) --idx;
+        if (!children[idx]->insert(k, std::move(v), mode)) return false;
+        counts[idx]++;
+        if (insertMax) keys.set(idx, k);
+        if (children[idx]->keys.size() > 2 * t) {
+            splitChild(idx);
+        }
+        return true;
+    }
+
+    void splitChild(size_t idx) {
+        BTREE_COUNT(splits);
+        BPlusNode<KeyType, ValueType, T>* left = children[idx];
+        int num = left->keys.size();
+        int midIndex = num / 2;
+
+        // 创建新内部节点
+        BPlusNode<KeyType, ValueType, T>* right = nullptr;
+        if (left->isLeaf) {
+            BPlusLeafNode<KeyType, ValueType, T> *newNode = BPlusLeafNode<KeyType, ValueType, T>::create(this->alloc, t);
+            right = newNode;
+            BPlusLeafNode<KeyType, ValueType, T>* leftNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(left);
+            // 插入到链表
+            newNode->next = leftNode->next;
+            if (leftNode->next) leftNode->next->prev = newNode;
+            leftNode->next = newNode;
+            newNode->prev = leftNode;
+            // value 随 key 一起移到右半
+            if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+                newNode->values.assign(std::make_move_iterator(leftNode->values.begin() + midIndex),
+                                       std::make_move_iterator(leftNode->values.end()));
+                leftNode->values.resize(midIndex);
+            }
+        }
+        else {
+            BPlusInternalNode<KeyType, ValueType, T> *newNode = BPlusInternalNode<KeyType, ValueType, T>::create(this->alloc, t);
+            right = newNode;
+            // 右半部分 children 和 keys 移动到 right
+            BPlusInternalNode<KeyType, ValueType, T>* leftNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(left);
+            // children 从 midIndex 开始移
+            newNode->children.assign(leftNode->children.begin() + midIndex, leftNode->children.end());
+            newNode->counts.assign(leftNode->counts.begin() + midIndex, leftNode->counts.end());
+            // 更新 parent 指针
+            for (auto child : newNode->children) {
+                child->parent = newNode;
+            }
+            leftNode->children.resize(midIndex);
+            leftNode->counts.resize(midIndex);
+        }
+
+        // keys 从 midIndex 开始移（keys 数 = children.size()-1）
+        right->keys.assign(left->keys.begin() + midIndex, left->keys.end());
+
+        // 剪裁原 left
+        left->keys.resize(midIndex);
+        // 将 upKey 插入到父节点
+        right->parent = left->parent;
+        // 右半沿用原分隔 key；叶子分裂时左半的分隔 key 只需介于左半最大和右半最小之间，取最短的
+        KeyType rightSep = keys[idx];
+        keys.set(idx, left->isLeaf ? bplusSeparator(left->keys.back(), right->keys.front()) : left->keys.back());
+        keys.insert(keys.begin() + idx + 1, rightSep);
+        children.insert(children.begin() + idx + 1, right);
+        size_t rightCount = subtreeCount(right);
+        counts[idx] -= rightCount;
+        counts.insert(counts.begin() + idx + 1, rightCount);
+    }
+
+    // 删除 key 的公共接口
+    bool remove(const KeyType& k) override {
+        size_t idx = this->findKey(k);
+        if (idx == keys.size()) return false;
+        if (!children[idx]->remove(k)) return false;
+        counts[idx]--;
+        keys.set(idx, children[idx]->keys.back());
+        if (children[idx]->keys.size() < t) {
+            fill(idx);
+        }
+        return true;
+    }
+
+    // fill children[idx] 使其至少有 t 个关键字
+    void fill(size_t idx) {
+        BTREE_COUNT(fills);
+        BPlusNode<KeyType, ValueType, T>* cur = children[idx];
+        // 如果前兄弟有多余，借
+        if (idx > 0 && children[idx-1]->keys.size() > t) {
+            borrowFromPrev(idx);
+        }
+        // 后兄弟有多余，借
+        else if ((idx + 1) < keys.size() && children[idx + 1]->keys.size() > t) {
+            borrowFromNext(idx);
+        }
+        else {
+            // 合并
+            if (idx > 0) {
+                mergePrev(idx);
             }
             else {
                 mergeNext(idx);
@@ -478,217 +1851,3599 @@ public:
         }
     }
 
-    void borrowFromPrev(size_t idx) {
-        BPlusNode<KeyType>* child = children[idx];
-        BPlusNode<KeyType>* sibling = children[idx - 1];
-        // child 的 keys 后移，腾出位置
-        child->keys.insert(child->keys.begin(), sibling->keys.back());
-        sibling->keys.pop_back();
-        if (!child->isLeaf) {
-            BPlusInternalNode<KeyType>* childNode = static_cast<BPlusInternalNode<KeyType>*>(child);
-            BPlusInternalNode<KeyType>* siblingNode = static_cast<BPlusInternalNode<KeyType>*>(sibling);
-            childNode->children.insert(childNode->children.begin(), siblingNode->children.back());
-            siblingNode->children.pop_back();
+    void borrowFromPrev(size_t idx) {
+        BTREE_COUNT(borrowsFromPrev);
+        BPlusNode<KeyType, ValueType, T>* child = children[idx];
+        BPlusNode<KeyType, ValueType, T>* sibling = children[idx - 1];
+        // child 的 keys 后移，腾出位置
+        child->keys.insert(child->keys.begin(), sibling->keys.back());
+        sibling->keys.pop_back();
+        size_t moved = 1;
+        if (!child->isLeaf) {
+            BPlusInternalNode<KeyType, ValueType, T>* childNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(child);
+            BPlusInternalNode<KeyType, ValueType, T>* siblingNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(sibling);
+            childNode->children.insert(childNode->children.begin(), siblingNode->children.back());
+            siblingNode->children.pop_back();
+            moved = siblingNode->counts.back();
+            childNode->counts.insert(childNode->counts.begin(), moved);
+            siblingNode->counts.pop_back();
+        }
+        else if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+            auto childNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(child);
+            auto siblingNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(sibling);
+            childNode->values.insert(childNode->values.begin(), std::move(siblingNode->values.back()));
+            siblingNode->values.pop_back();
+        }
+        sibling->parent = child->parent;
+        counts[idx - 1] -= moved;
+        counts[idx] += moved;
+        // 把 sibling 最后一个 key 上移到父节点
+        keys.set(idx - 1, sibling->keys.back());
+    }
+
+    void borrowFromNext(size_t idx) {
+        BTREE_COUNT(borrowsFromNext);
+        BPlusNode<KeyType, ValueType, T>* child = children[idx];
+        BPlusNode<KeyType, ValueType, T>* sibling = children[idx + 1];
+        // child 的 keys 后移，腾出位置
+        child->keys.insert(child->keys.end(), sibling->keys.front());
+        sibling->keys.pop_front();
+        size_t moved = 1;
+        if (!child->isLeaf) {
+            BPlusInternalNode<KeyType, ValueType, T>* childNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(child);
+            BPlusInternalNode<KeyType, ValueType, T>* siblingNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(sibling);
+            childNode->children.insert(childNode->children.end(), siblingNode->children.front());
+            siblingNode->children.pop_front();
+            moved = siblingNode->counts.front();
+            childNode->counts.push_back(moved);
+            siblingNode->counts.pop_front();
+        }
+        else if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+            auto childNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(child);
+            auto siblingNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(sibling);
+            childNode->values.push_back(std::move(siblingNode->values.front()));
+            siblingNode->values.pop_front();
+        }
+        sibling->parent = child->parent;
+        counts[idx + 1] -= moved;
+        counts[idx] += moved;
+        // 把 sibling 最后一个 key 上移到父节点
+        keys.set(idx, child->keys.back());
+    }
+
+    // 合并 children[idx] 和 children[idx-1]
+    void mergePrev(size_t idx) {
+        BTREE_COUNT(merges);
+        BPlusNode<KeyType, ValueType, T>* child = children[idx];
+        BPlusNode<KeyType, ValueType, T>* sibling = children[idx - 1];
+        // child 的 keys 后移，腾出位置
+        child->keys.insert(child->keys.begin(), sibling->keys.begin(), sibling->keys.end());
+        sibling->keys.clear();
+        if (!child->isLeaf) {
+            BPlusInternalNode<KeyType, ValueType, T>* childNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(child);
+            BPlusInternalNode<KeyType, ValueType, T>* siblingNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(sibling);
+            childNode->children.insert(childNode->children.begin(), siblingNode->children.begin(), siblingNode->children.end());
+            siblingNode->children.clear();
+            childNode->counts.insert(childNode->counts.begin(), siblingNode->counts.begin(), siblingNode->counts.end());
+            siblingNode->counts.clear();
+        }
+        // 把 sibling 最后一个 key 上移到父节点
+        keys.erase(keys.begin() + idx - 1);
+        children.erase(children.begin() + idx - 1);
+        counts[idx] += counts[idx - 1];
+        counts.erase(counts.begin() + idx - 1);
+
+        if (child->isLeaf) {
+            BPlusLeafNode<KeyType, ValueType, T>* childNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(child);
+            BPlusLeafNode<KeyType, ValueType, T>* siblingNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(sibling);
+            childNode->prev = siblingNode->prev;
+            if (siblingNode->prev) siblingNode->prev->next = childNode;
+            if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+                childNode->values.insert(childNode->values.begin(),
+                                         std::make_move_iterator(siblingNode->values.begin()),
+                                         std::make_move_iterator(siblingNode->values.end()));
+            }
+        }
+        
+        sibling->dispose();
+    }
+
+    // 合并 children[idx] 和 children[idx+1]
+    void mergeNext(size_t idx) {
+        BTREE_COUNT(merges);
+        BPlusNode<KeyType, ValueType, T>* child = children[idx];
+        BPlusNode<KeyType, ValueType, T>* sibling = children[idx + 1];
+        // child 的 keys 后移，腾出位置
+        child->keys.insert(child->keys.end(), sibling->keys.begin(), sibling->keys.end());
+        sibling->keys.clear();
+        if (!child->isLeaf) {
+            BPlusInternalNode<KeyType, ValueType, T>* childNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(child);
+            BPlusInternalNode<KeyType, ValueType, T>* siblingNode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(sibling);
+            childNode->children.insert(childNode->children.end(), siblingNode->children.begin(), siblingNode->children.end());
+            siblingNode->children.clear();
+            childNode->counts.insert(childNode->counts.end(), siblingNode->counts.begin(), siblingNode->counts.end());
+            siblingNode->counts.clear();
+        }
+
+        // 把 sibling 最后一个 key 上移到父节点
+        keys.erase(keys.begin() + idx + 1);
+        children.erase(children.begin() + idx + 1);
+        counts[idx] += counts[idx + 1];
+        counts.erase(counts.begin() + idx + 1);
+        keys.set(idx, child->keys.back());
+
+        if (child->isLeaf) {
+            BPlusLeafNode<KeyType, ValueType, T>* childNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(child);
+            BPlusLeafNode<KeyType, ValueType, T>* siblingNode = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(sibling);
+            childNode->next = siblingNode->next;
+            if (siblingNode->next) siblingNode->next->prev = childNode;
+            if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+                childNode->values.insert(childNode->values.end(),
+                                         std::make_move_iterator(siblingNode->values.begin()),
+                                         std::make_move_iterator(siblingNode->values.end()));
+            }
+        }
+
+        sibling->dispose();
+    }
+
+    // 遍历（调试用）
+    void traverse(int depth = 0) {
+        // 缩进
+        for (int i = 0; i < depth; ++i) std::cout << "  ";
+        std::cout << "[";
+        for (int i = 0; i < keys.size(); ++i) {
+            std::cout << keys[i];
+            if (i + 1 < keys.size()) std::cout << ", ";
+        }
+        std::cout << "]";
+        std::cout << (isLeaf ? " (leaf)" : "") << "\n";
+        if (!isLeaf) {
+            for (int i = 0; i < children.size(); ++i) {
+                children[i]->traverse(depth + 1);
+            }
+        }
+    }
+};
+
+// 预取提示，不支持的编译器上退化为空操作
+#if defined(__GNUC__) || defined(__clang__)
+#define BPLUS_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define BPLUS_PREFETCH(p) ((void)0)
+#endif
+
+// 沿叶子链表移动的双向迭代器：(leaf, pos) 表示 leaf->keys[pos]
+// end() 为 (最右叶, keys.size())，空树为 (nullptr, 0)，因此 --end() 可用于反向遍历
+template<typename KeyType, typename ValueType, size_t T = 0>
+class BPlusTreeIterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = KeyType;
+    using difference_type = std::ptrdiff_t;
+    // std::string key 按值返回，此时 -> 通过临时对象访问
+    using reference = typename BPlusKeyArray<KeyType>::const_reference;
+    struct ArrowProxy {
+        KeyType key;
+        const KeyType* operator->() const { return &key; }
+    };
+    using pointer = std::conditional_t<std::is_reference<reference>::value, const KeyType*, ArrowProxy>;
+
+    BPlusTreeIterator() : leaf(nullptr), pos(0) {}
+    BPlusTreeIterator(BPlusLeafNode<KeyType, ValueType, T>* _leaf, size_t _pos) : leaf(_leaf), pos(_pos) {
+        normalize();
+    }
+
+    reference operator*() const { return leaf->keys[pos]; }
+    pointer operator->() const {
+        if constexpr (std::is_reference<reference>::value) return &leaf->keys[pos];
+        else return ArrowProxy{ leaf->keys[pos] };
+    }
+    reference key() const { return leaf->keys[pos]; }
+    // 只在 ValueType 不为 BPlusNoValue 时可用
+    ValueType& value() const { return leaf->values[pos]; }
+
+    BPlusTreeIterator& operator++() {
+        ++pos;
+        normalize();
+        return *this;
+    }
+    BPlusTreeIterator operator++(int) {
+        BPlusTreeIterator tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    BPlusTreeIterator& operator--() {
+        if (pos == 0) {
+            leaf = leaf->prev;
+            pos = leaf->keys.size();
+            BPLUS_PREFETCH(leaf->prev);
+        }
+        --pos;
+        return *this;
+    }
+    BPlusTreeIterator operator--(int) {
+        BPlusTreeIterator tmp = *this;
+        --*this;
+        return tmp;
+    }
+
+    bool operator==(const BPlusTreeIterator& o) const { return leaf == o.leaf && pos == o.pos; }
+    bool operator!=(const BPlusTreeIterator& o) const { return !(*this == o); }
+
+private:
+    BPlusLeafNode<KeyType, ValueType, T>* leaf;
+    size_t pos;
+
+    // 当前叶子读完则跳到下一叶，最右叶停在 keys.size() 作为 end
+    void normalize() {
+        while (leaf && pos == leaf->keys.size() && leaf->next) {
+            leaf = leaf->next;
+            pos = 0;
+            // 消费当前叶时预取下一叶
+            BPLUS_PREFETCH(leaf->next);
+        }
+    }
+};
+
+// [first, last) 区间视图，可用于 range-for，也可反向遍历
+template<typename Iter>
+struct BPlusRange {
+    Iter first, last;
+    Iter begin() const { return first; }
+    Iter end() const { return last; }
+    std::reverse_iterator<Iter> rbegin() const { return std::reverse_iterator<Iter>(last); }
+    std::reverse_iterator<Iter> rend() const { return std::reverse_iterator<Iter>(first); }
+    bool empty() const { return first == last; }
+};
+
+// 只读的冻结 B+ 树（CSS-tree 布局）：所有 key 有序放在一个连续数组里，每 B 个划为一个叶块；
+// 上面各层索引节点也是定长 B 个 key，从根开始逐层连续存放，不存指针：
+// 某层第 j 个节点的第 c 个孩子是下一层的第 j*(B+1)+c 个节点（最下一层索引的孩子是叶块）。
+// 索引 key 为对应孩子子树的最大 key，缺失的孩子用全树最大 key 填充。
+// 索引、key、value 依次放在一块按 NodeBytes 对齐的内存里，每个节点恰好占 NodeBytes 字节（B 不小于 4 时），
+// 查找每层只读一个节点，不做指针跳转
+template<typename KeyType, typename ValueType = BPlusNoValue, size_t NodeBytes = 64>
+class FrozenBPlusTree {
+    static_assert((NodeBytes & (NodeBytes - 1)) == 0, "NodeBytes must be a power of two");
+    static_assert(alignof(KeyType) <= NodeBytes && alignof(ValueType) <= NodeBytes, "sections are NodeBytes aligned");
+public:
+    static constexpr bool hasValue = !std::is_same<ValueType, BPlusNoValue>::value;
+    static constexpr size_t B = std::max<size_t>(4, NodeBytes / sizeof(KeyType));
+    using iterator = const KeyType*;
+
+    FrozenBPlusTree() = default;
+
+    // keys 有序（可重复）；存 value 时 values[i] 对应 keys[i]
+    explicit FrozenBPlusTree(std::vector<KeyType> keys, std::vector<ValueType> values = {}) {
+        n = keys.size();
+        if (n == 0) return;
+        // 自底向上算出每层节点数，levelNodes 按从根到下的顺序
+        std::vector<size_t> counts;
+        for (size_t c = (n + B - 1) / B; c > 1; ) {
+            c = (c + B) / (B + 1);
+            counts.push_back(c);
+        }
+        levelNodes.assign(counts.rbegin(), counts.rend());
+        size_t indexKeys = 0;
+        for (size_t c : levelNodes) {
+            levelStart.push_back(indexKeys);
+            indexKeys += c * B;
+        }
+
+        size_t keysOff = nodeAlignUp(indexKeys * sizeof(KeyType), NodeBytes);
+        size_t valuesOff = nodeAlignUp(keysOff + n * sizeof(KeyType), NodeBytes);
+        blockBytes = hasValue ? valuesOff + n * sizeof(ValueType) : keysOff + n * sizeof(KeyType);
+        block.reset(static_cast<char*>(::operator new(blockBytes, std::align_val_t(NodeBytes))));
+        index = reinterpret_cast<KeyType*>(block.get());
+        data = reinterpret_cast<KeyType*>(block.get() + keysOff);
+        std::uninitialized_move(keys.begin(), keys.end(), data);
+        if constexpr (hasValue) {
+            vals = reinterpret_cast<ValueType*>(block.get() + valuesOff);
+            std::uninitialized_move(values.begin(), values.end(), vals);
+        }
+
+        // 逐层向上填索引：childMax 为下一层各节点子树的最大 key
+        const KeyType& globalMax = data[n - 1];
+        std::vector<KeyType> childMax, nodeMax;
+        for (size_t j = 0; j < (n + B - 1) / B; ++j)
+            childMax.push_back(data[std::min(n, (j + 1) * B) - 1]);
+        for (size_t l = levelNodes.size(); l-- > 0; ) {
+            KeyType* level = index + levelStart[l];
+            nodeMax.clear();
+            for (size_t j = 0; j < levelNodes[l]; ++j) {
+                for (size_t c = 0; c < B; ++c) {
+                    size_t child = j * (B + 1) + c;
+                    new (level + j * B + c) KeyType(child < childMax.size() ? childMax[child] : globalMax);
+                }
+                nodeMax.push_back(childMax[std::min(childMax.size(), (j + 1) * (B + 1)) - 1]);
+            }
+            childMax.swap(nodeMax);
+        }
+    }
+
+    FrozenBPlusTree(FrozenBPlusTree&& o) noexcept { *this = std::move(o); }
+    FrozenBPlusTree& operator=(FrozenBPlusTree&& o) noexcept {
+        if (this != &o) {
+            reset();
+            block = std::move(o.block);
+            index = std::exchange(o.index, nullptr);
+            data = std::exchange(o.data, nullptr);
+            vals = std::exchange(o.vals, nullptr);
+            n = std::exchange(o.n, 0);
+            blockBytes = std::exchange(o.blockBytes, 0);
+            levelNodes = std::move(o.levelNodes);
+            levelStart = std::move(o.levelStart);
+        }
+        return *this;
+    }
+    ~FrozenBPlusTree() { reset(); }
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    // 索引层数加上叶块这一层
+    size_t height() const { return n ? levelNodes.size() + 1 : 0; }
+    // 占用的总字节数
+    size_t bytes() const { return sizeof(*this) + blockBytes + levelNodes.size() * 2 * sizeof(size_t); }
+
+    iterator begin() const { return data; }
+    iterator end() const { return data + n; }
+
+    // 第一个 >= k 的位置：每层在一个节点里数出 < k 的 key 个数即得孩子下标
+    iterator lower_bound(const KeyType& k) const {
+        if (n == 0 || data[n - 1] < k) return end();
+        size_t j = 0;
+        for (size_t l = 0; l < levelNodes.size(); ++l)
+            j = j * (B + 1) + nodeLowerBound(index + levelStart[l] + j * B, B, k);
+        size_t from = j * B;
+        return data + from + nodeLowerBound(data + from, std::min(B, n - from), k);
+    }
+
+    // 第一个 > k 的位置
+    iterator upper_bound(const KeyType& k) const {
+        iterator it = lower_bound(k);
+        while (it != end() && !(k < *it)) ++it;
+        return it;
+    }
+
+    // 区间 [lo, hi) 内的所有 key
+    BPlusRange<iterator> range(const KeyType& lo, const KeyType& hi) const {
+        if (!(lo < hi)) {
+            iterator it = lower_bound(lo);
+            return { it, it };
+        }
+        return { lower_bound(lo), lower_bound(hi) };
+    }
+
+    bool contains(const KeyType& k) const {
+        iterator it = lower_bound(k);
+        return it != end() && !(k < *it);
+    }
+
+    // it 处 key 对应的 value
+    const ValueType& value(iterator it) const { return vals[it - data]; }
+
+    // 查找 k 对应的 value，不存在返回 nullptr
+    const ValueType* find(const KeyType& k) const {
+        iterator it = lower_bound(k);
+        return it != end() && !(k < *it) ? &value(it) : nullptr;
+    }
+
+private:
+    struct AlignedDelete {
+        void operator()(char* p) const { ::operator delete(p, std::align_val_t(NodeBytes)); }
+    };
+
+    std::unique_ptr<char, AlignedDelete> block;
+    KeyType* index = nullptr;   // 各层索引节点，从根所在层开始
+    KeyType* data = nullptr;    // 全部 key，有序
+    ValueType* vals = nullptr;
+    size_t n = 0;
+    size_t blockBytes = 0;
+    std::vector<size_t> levelNodes;  // 每层索引节点数，[0] 为根所在层
+    std::vector<size_t> levelStart;  // 每层在 index 中的起始下标
+
+    void reset() {
+        if (!block) return;
+        size_t indexKeys = 0;
+        for (size_t c : levelNodes) indexKeys += c * B;
+        std::destroy_n(index, indexKeys);
+        std::destroy_n(data, n);
+        if constexpr (hasValue) std::destroy_n(vals, n);
+        block.reset();
+    }
+};
+
+// B+ 树快照文件（本机字节序）：头部 | 各层节点，叶子层在前、根在最后 | 8 字节校验和。
+// 每层先写节点数，每个节点写 key 数和 key 数组，叶子再写 value 数组；各段都补齐到 8 字节，
+// 因此 mmap 后可以直接按类型读取。内部节点的孩子数等于 key 数，依次取下一层的节点
+struct BPlusSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t keyBytes;    // sizeof(KeyType)
+    uint32_t valueBytes;  // sizeof(ValueType)，只存 key 时为 0
+    uint32_t levels;      // 0 表示空树
+    uint64_t t;
+    uint64_t count;       // 元素个数
+};
+constexpr char bplusSnapshotMagic[8] = { 'B', 'P', 'T', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t bplusSnapshotVersion = 1;
+
+// 快照校验和：按 8 字节一个字做 FNV-1a 式的异或-乘法，bytes 须为 8 的倍数。
+// 乘奇数是双射，任意单个字的改动都会反映到结果上
+inline uint64_t snapshotChecksum(uint64_t h, const char* p, size_t bytes) {
+    for (size_t i = 0; i < bytes; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    return h;
+}
+constexpr uint64_t snapshotChecksumSeed = 0xcbf29ce484222325ULL;
+
+// Alloc 为节点分配策略（SlabArena 或 HeapNodeAllocator），每棵树持有自己的一份（splitAt 切出的树与原树共用）；
+// T 不为 0 时最小度数在编译期确定（见 FixedBPlusTree），此时可以默认构造
+template<typename KeyType, typename ValueType = BPlusNoValue, typename Alloc = SlabArena, size_t T = 0>
+class BPlusTree : public DegreeHolder<size_t, T> {
+public:
+    using iterator = BPlusTreeIterator<KeyType, ValueType, T>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    using DegreeHolder<size_t, T>::t;
+    BPlusNode<KeyType, ValueType, T>* root;
+    BPlusTree(int _t) : DegreeHolder<size_t, T>(_t), root(nullptr) {}
+    template<size_t U = T, typename = std::enable_if_t<U != 0>>
+    BPlusTree() : BPlusTree(int(U)) {}
+    ~BPlusTree() { clear(); }
+    // 节点记录了本树分配器的地址，树不可拷贝或移动
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    iterator begin() {
+        if (!root) return iterator();
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (!cur->isLeaf)
+            cur = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur)->children.front();
+        return iterator(static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur), 0);
+    }
+
+    iterator end() {
+        if (!root) return iterator();
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (!cur->isLeaf)
+            cur = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur)->children.back();
+        return iterator(static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur), cur->keys.size());
+    }
+
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+
+    // 第一个 >= k 的位置，只从根下降一次
+    iterator lower_bound(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
+        auto leaf = findLeaf(k);
+        if (!leaf) return end();
+        BPLUS_PREFETCH(leaf->next);
+        return iterator(leaf, leaf->findKey(k));
+    }
+
+    // 第一个 > k 的位置
+    iterator upper_bound(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
+        auto leaf = findLeaf(k);
+        if (!leaf) return end();
+        BPLUS_PREFETCH(leaf->next);
+        // 重复 key 可能跨过叶子边界，一直跳到下一个不等于 k 的叶子
+        size_t idx = leaf->findKey(k);
+        for (;;) {
+            while (idx < leaf->keys.size() && leaf->keyEquals(idx, k)) ++idx;
+            if (idx < leaf->keys.size() || !leaf->next) break;
+            leaf = leaf->next;
+            idx = 0;
+        }
+        return iterator(leaf, idx);
+    }
+
+    // 区间 [lo, hi) 内的所有 key，按叶子链表顺序输出
+    BPlusRange<iterator> range(const KeyType& lo, const KeyType& hi) {
+        if (!(lo < hi)) {
+            iterator it = lower_bound(lo);
+            return { it, it };
+        }
+        return { lower_bound(lo), lower_bound(hi) };
+    }
+
+    // 元素个数，由根的子树计数求和
+    size_t size() const {
+        return root ? BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(root) : 0;
+    }
+
+    // 第 i 小（从 0 开始）的元素，i >= size() 时返回 end()。按子树计数下降，O(t log n)
+    iterator select(size_t i) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
+        if (i >= size()) return end();
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (!cur->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            size_t c = 0;
+            while (i >= inode->counts[c]) i -= inode->counts[c++];
+            cur = inode->children[c];
+        }
+        return iterator(static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur), i);
+    }
+
+    // 小于 k 的元素个数，即 lower_bound(k) 的序号
+    size_t rank(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
+        if (!root) return 0;
+        size_t r = 0;
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (!cur->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            size_t idx = inode->findKey(k);
+            r = std::accumulate(inode->counts.begin(), inode->counts.begin() + idx, r);
+            // 比整棵子树都大
+            if (idx == inode->keys.size()) return r;
+            cur = inode->children[idx];
+        }
+        return r + cur->findKey(k);
+    }
+
+    // 搜索
+    BPlusLeafNode<KeyType, ValueType, T>* search(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
+        auto leaf = findLeaf(k);
+        if (!leaf) return nullptr;
+        // 在 leaf->keys 中查找
+        size_t idx = leaf->findKey(k);
+        if (idx < leaf->keys.size() && leaf->keyEquals(idx, k))
+            return leaf;
+        return nullptr;
+    }
+
+    // 同 findLeaf，并给出该叶子负责的 key 区间 (lo, hi]，hasLo/hasHi 为 false 表示该侧无界。
+    // k 比某个节点记录的最大 key 还大时，从该节点起沿最右孩子下降，raiseFrom 指向该节点，
+    // 插入后需用 raiseMaxPath 更新这条路径上的最大 key；否则 raiseFrom 为 nullptr。
+    // path 记下经过的 (内部节点, 孩子下标)，直接改动叶子后用来更新子树计数
+    BPlusLeafNode<KeyType, ValueType, T>* findLeafBounded(const KeyType& k, KeyType& lo, bool& hasLo, KeyType& hi,
+                                                      bool& hasHi, BPlusInternalNode<KeyType, ValueType, T>*& raiseFrom,
+                                                      std::vector<std::pair<BPlusInternalNode<KeyType, ValueType, T>*, size_t>>& path) {
+        hasLo = hasHi = false;
+        raiseFrom = nullptr;
+        path.clear();
+        if (!root) return nullptr;
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (!cur->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            size_t idx = inode->findKey(k);
+            if (idx == inode->keys.size()) {
+                if (!raiseFrom) raiseFrom = inode;
+                --idx;
+            }
+            else {
+                hi = inode->keys[idx];
+                hasHi = true;
+            }
+            if (idx > 0) {
+                lo = inode->keys[idx - 1];
+                hasLo = true;
+            }
+            path.emplace_back(inode, idx);
+            cur = inode->children[idx];
+        }
+        return static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur);
+    }
+
+    // 把 from 沿最右孩子到 leaf 这条路径上记录的最大 key 改为 leaf 的最大 key
+    static void raiseMaxPath(BPlusInternalNode<KeyType, ValueType, T>* from, BPlusLeafNode<KeyType, ValueType, T>* leaf) {
+        BPlusNode<KeyType, ValueType, T>* cur = from;
+        while (cur && !cur->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            inode->keys.set(inode->keys.size() - 1, leaf->keys.back());
+            cur = inode->children.back();
+        }
+    }
+
+    // 向下查找 k 所在的叶子；比所有 key 都大时返回 nullptr
+    BPlusLeafNode<KeyType, ValueType, T>* findLeaf(const KeyType& k) {
+        if (!root) return nullptr;
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (!cur->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            size_t idx = inode->findKey(k);
+            if (idx == inode->keys.size()) return nullptr;
+            cur = inode->children[idx];
+        }
+        return static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur);
+    }
+
+    // 插入（允许重复 key，value 为默认值）
+    void insert(const KeyType& k) {
+        insertImpl(k, ValueType(), BPlusInsertMode::Duplicate);
+    }
+
+    // 查找 k 对应的 value，不存在返回 nullptr
+    ValueType* find(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Find);
+        auto leaf = findLeaf(k);
+        if (!leaf) return nullptr;
+        size_t idx = leaf->findKey(k);
+        if (idx < leaf->keys.size() && leaf->keyEquals(idx, k))
+            return &leaf->values[idx];
+        return nullptr;
+    }
+
+    // k 不存在则插入，存在则覆盖 value；返回是否新插入
+    template<typename V>
+    bool insert_or_assign(const KeyType& k, V&& v) {
+        return insertImpl(k, ValueType(std::forward<V>(v)), BPlusInsertMode::Assign);
+    }
+
+    // k 不存在时用 args 构造 value 并插入，存在时不改动；返回是否新插入
+    template<typename... Args>
+    bool emplace(const KeyType& k, Args&&... args) {
+        return insertImpl(k, ValueType(std::forward<Args>(args)...), BPlusInsertMode::KeepExisting);
+    }
+
+    // value 一路 move 到叶子，不做拷贝
+    bool insertImpl(const KeyType& k, ValueType&& v, BPlusInsertMode mode) {
+        BTREE_STATS_SCOPE(TreeOp::Insert);
+        if (!root) {
+            auto leaf = BPlusLeafNode<KeyType, ValueType, T>::create(alloc.get(), t);
+            leaf->insert(k, std::move(v), mode);
+            root = leaf;
+            return true;
+        }
+        if (!root->insert(k, std::move(v), mode)) return false;
+        if (root->keys.size() > 2 * t) {
+            auto s = BPlusInternalNode<KeyType, ValueType, T>::create(alloc.get(), t);
+            s->keys.push_back(root->keys.back());
+            s->children.push_back(root);
+            s->counts.push_back(BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(root));
+            root->parent = s;
+            root = s;
+            s->splitChild(0);
+        }
+        return true;
+    }
+
+    // 批量查找：out[i] 为 keys[i] 所在叶子（同 search），不存在为 nullptr
+    void searchBatch(const KeyType* keys, size_t n, BPlusLeafNode<KeyType, ValueType, T>** out) {
+        BTREE_STATS_SCOPE(TreeOp::Batch);
+        std::fill(out, out + n, nullptr);
+        lookupBatch(keys, n, [&](size_t i, BPlusLeafNode<KeyType, ValueType, T>* leaf, size_t) { out[i] = leaf; });
+    }
+
+    // 批量查找：out[i] 为 keys[i] 对应的 value（同 find），不存在为 nullptr
+    void findBatch(const KeyType* keys, size_t n, ValueType** out) {
+        BTREE_STATS_SCOPE(TreeOp::Batch);
+        std::fill(out, out + n, nullptr);
+        lookupBatch(keys, n, [&](size_t i, BPlusLeafNode<KeyType, ValueType, T>* leaf, size_t idx) {
+            out[i] = &leaf->values[idx];
+        });
+    }
+
+    // 批量插入，返回新插入的个数。只存 key 时元素为 key，按 insert 允许重复；
+    // 存 value 时元素为 (key, value) 对，按 insert_or_assign 覆盖，批内重复 key 以靠后的为准。
+    // 先排序，落在同一叶子且不会引起分裂的连续 key 直接插入该叶子，只在换叶子或需要分裂时从根下降；
+    // 超过全树最大 key 的一串 key 追加到最右叶后，路径上的最大 key 只在离开该叶子时更新一次
+    template<typename ForwardIt>
+    size_t insertBatch(ForwardIt first, ForwardIt last) {
+        BTREE_STATS_SCOPE(TreeOp::Batch);
+        constexpr bool hasValue = BPlusLeafNode<KeyType, ValueType, T>::hasValue;
+        BPlusInsertMode mode = hasValue ? BPlusInsertMode::Assign : BPlusInsertMode::Duplicate;
+        std::vector<std::pair<KeyType, ValueType>> items;
+        items.reserve(std::distance(first, last));
+        for (; first != last; ++first) {
+            if constexpr (hasValue) items.emplace_back(first->first, first->second);
+            else items.emplace_back(*first, ValueType());
+        }
+        auto byKey = [](const auto& a, const auto& b) { return a.first < b.first; };
+        // 覆盖语义要求相同 key 保持原顺序；只存 key 时相同 key 不可区分，不必稳定
+        if constexpr (hasValue) std::stable_sort(items.begin(), items.end(), byKey);
+        else std::sort(items.begin(), items.end(), byKey);
+
+        size_t inserted = 0;
+        BPlusLeafNode<KeyType, ValueType, T>* leaf = nullptr;
+        BPlusInternalNode<KeyType, ValueType, T>* raiseFrom = nullptr;
+        std::vector<std::pair<BPlusInternalNode<KeyType, ValueType, T>*, size_t>> path;
+        size_t added = 0;  // 直接插入当前叶子、尚未计入 path 上子树计数的个数
+        // 离开当前叶子：更新路径上的最大 key 和子树计数
+        auto leave = [&] {
+            raiseMaxPath(raiseFrom, leaf);
+            for (auto& step : path) step.first->counts[step.second] += added;
+            added = 0;
+        };
+        KeyType lo{}, hi{};
+        bool hasLo = false, hasHi = false;
+        for (auto& item : items) {
+            const KeyType& k = item.first;
+            if (!leaf || (hasLo && !(lo < k)) || (hasHi && hi < k)) {
+                leave();
+                leaf = findLeafBounded(k, lo, hasLo, hi, hasHi, raiseFrom, path);
+            }
+            // 叶子还有空位，插入不会引起分裂
+            if (leaf && leaf->keys.size() < 2 * t) {
+                bool fresh = leaf->insert(k, std::move(item.second), mode);
+                inserted += fresh;
+                added += fresh;
+            }
+            else {
+                leave();
+                inserted += insertImpl(k, std::move(item.second), mode);
+                leaf = nullptr;
+                raiseFrom = nullptr;
+                path.clear();
+            }
+        }
+        leave();
+        return inserted;
+    }
+
+    // 删除，返回 k 是否存在
+    bool remove(const KeyType& k) {
+        return erase(k);
+    }
+
+    // 删除 k 及其 value，返回 k 是否存在
+    bool erase(const KeyType& k) {
+        BTREE_STATS_SCOPE(TreeOp::Erase);
+        if (!root || !root->remove(k)) return false;
+        if (root->isLeaf) {
+            if (root->keys.size() == 0) {
+                root->dispose();
+                root = nullptr;
+            }
+        }
+        else {
+            if (root->keys.size() == 1) {
+                BPlusInternalNode<KeyType, ValueType, T>* tmp = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(root);
+                root = tmp->children[0];
+                root->parent = nullptr;
+                tmp->dispose();
+            }
+        }
+        return true;
+    }
+
+    // 删除 [lo, hi) 内的全部元素，返回删除个数。在 lo、hi 处把树切开，中间一段的节点整棵释放，
+    // 不逐个删除也不借位合并，再把两边接回来：O(t^2 log n) 加上被删节点数
+    size_t eraseRange(const KeyType& lo, const KeyType& hi) {
+        BTREE_STATS_SCOPE(TreeOp::Erase);
+        if (!root || !(lo < hi)) return 0;
+        auto left = splitPieces({ root, heightOf(root) }, lo);
+        auto right = splitPieces(left.second, hi);
+        size_t n = right.first.root ? BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(right.first.root) : 0;
+        destroy(right.first.root);
+        root = joinPieces(left.first, right.second).root;
+        return n;
+    }
+
+    // 把 >= k 的元素移到空树 right，本树留下 < k 的部分，O(t^2 log n)。
+    // 搬过去的是整棵子树，right 从此与本树共用本树的分配器
+    void splitAt(const KeyType& k, BPlusTree& right) {
+        BTREE_STATS_SCOPE(TreeOp::Batch);
+        if (&right == this || right.root) throw std::invalid_argument("BPlusTree::splitAt: target must be another, empty tree");
+        if constexpr (T == 0) right.t = t;
+        if (!root) return;
+        auto parts = splitPieces({ root, heightOf(root) }, k);
+        root = parts.first.root;
+        right.root = parts.second.root;
+        if (right.root) right.adoptArenas(*this);
+    }
+
+    // 把 other 的全部元素并入本树，other 变为空树。两棵树的 key 区间不能交错，
+    // 即 other 整体不小于或整体不大于本树，否则抛 invalid_argument。
+    // 矮的一棵挂到高的一棵边缘路径上，O(t^2 log n)；other 的节点连同其分配器一起转给本树
+    void join(BPlusTree& other) {
+        BTREE_STATS_SCOPE(TreeOp::Batch);
+        if (&other == this || !other.root) return;
+        if (other.t != t) throw std::invalid_argument("BPlusTree::join: degree mismatch");
+        Piece mine{ root, heightOf(root) }, theirs{ other.root, heightOf(other.root) };
+        if (!root || !(edgeLeaf(other.root, false)->keys.front() < edgeLeaf(root, true)->keys.back()))
+            root = joinPieces(mine, theirs).root;
+        else if (!(edgeLeaf(root, false)->keys.front() < edgeLeaf(other.root, true)->keys.back()))
+            root = joinPieces(theirs, mine).root;
+        else
+            throw std::invalid_argument("BPlusTree::join: key ranges overlap");
+        root->parent = nullptr;
+        other.root = nullptr;
+        adoptArenas(other);
+        other.alloc = std::make_shared<Alloc>();
+        other.adopted.clear();
+    }
+
+    // 从有序且无重复的 [first, last) 自底向上构建，替换原有内容；
+    // 存 value 时元素为 (key, value) 对，如 std::pair
+    // 叶子从左到右按 fillFactor 填充并串成链表，再一层层向上建内部节点；
+    // 节点保留 2t 的空余，之后插入不会立刻分裂
+    template<typename ForwardIt>
+    void bulkLoad(ForwardIt first, ForwardIt last, double fillFactor = 0.75) {
+        clear();
+        size_t n = std::distance(first, last);
+        if (n == 0) return;
+        size_t per = bulkPerNode(fillFactor, t, 2 * t);
+
+        std::vector<BPlusNode<KeyType, ValueType, T>*> level;
+        size_t nLeaves = bulkGroupCount(n, per, t);
+        level.reserve(nLeaves);
+        BPlusLeafNode<KeyType, ValueType, T>* prevLeaf = nullptr;
+        for (size_t j = 0; j < nLeaves; ++j) {
+            size_t sz = n / nLeaves + (j < n % nLeaves ? 1 : 0);
+            auto leaf = BPlusLeafNode<KeyType, ValueType, T>::create(alloc.get(), t);
+            for (size_t i = 0; i < sz; ++i, ++first) {
+                if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+                    leaf->keys.push_back(first->first);
+                    leaf->values.push_back(first->second);
+                }
+                else {
+                    leaf->keys.push_back(*first);
+                }
+            }
+            leaf->prev = prevLeaf;
+            if (prevLeaf) prevLeaf->next = leaf;
+            prevLeaf = leaf;
+            level.push_back(leaf);
+        }
+
+        // 内部节点的 keys[i] 为 children[i] 的最大 key，叶子之间取两者间最短的分隔 key
+        while (level.size() > 1) {
+            size_t m = level.size();
+            size_t nGroups = bulkGroupCount(m, per, t);
+            std::vector<BPlusNode<KeyType, ValueType, T>*> next;
+            next.reserve(nGroups);
+            size_t c = 0;
+            for (size_t g = 0; g < nGroups; ++g) {
+                size_t cnt = m / nGroups + (g < m % nGroups ? 1 : 0);
+                auto node = BPlusInternalNode<KeyType, ValueType, T>::create(alloc.get(), t);
+                for (size_t i = 0; i < cnt; ++i, ++c) {
+                    level[c]->parent = node;
+                    node->children.push_back(level[c]);
+                    node->counts.push_back(BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(level[c]));
+                    if (level[c]->isLeaf && c + 1 < m)
+                        node->keys.push_back(bplusSeparator(level[c]->keys.back(), level[c + 1]->keys.front()));
+                    else
+                        node->keys.push_back(level[c]->keys.back());
+                }
+                next.push_back(node);
+            }
+            level.swap(next);
+        }
+        root = level[0];
+    }
+
+    // 释放所有节点；key/value 无需析构、key 数组不占堆内存且分配器能整体回收时不遍历节点。
+    // 分配器还被别的树共用时只能逐个归还，清空后本树改用新的分配器，不再与其共用
+    void clear() {
+        bool shared = alloc.use_count() > 1;
+        for (auto& a : adopted) shared |= a.use_count() > 1;
+        if constexpr (Alloc::releasesAll && std::is_trivially_destructible<KeyType>::value
+                      && std::is_trivially_destructible<ValueType>::value
+                      && std::is_same<BPlusKeyArray<KeyType>, NodeArray<KeyType>>::value) {
+            if (!shared) {
+                alloc->release();
+                for (auto& a : adopted) a->release();
+            }
+            else {
+                destroy(root);
+            }
+        }
+        else {
+            destroy(root);
+        }
+        root = nullptr;
+        adopted.clear();
+        if (shared) alloc = std::make_shared<Alloc>();
+    }
+
+    static void destroy(BPlusNode<KeyType, ValueType, T>* node) {
+        if (!node) return;
+        if (!node->isLeaf) {
+            for (auto child : static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(node)->children)
+                destroy(child);
+        }
+        node->dispose();
+    }
+
+    // 遍历叶子链表，调试用
+    void traverseLeaves() {
+        // 找到最左叶
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        if (!cur) {
+            std::cout << "Empty B+ tree\n";
+            return;
+        }
+        while (!cur->isLeaf) {
+            cur = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur)->children[0];
+        }
+        BPlusLeafNode<KeyType, ValueType, T>* leaf = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur);
+        // 顺序打印所有叶
+        while (leaf) {
+            std::cout << "[";
+            for (const auto& k : leaf->keys) std::cout << k << " ";
+            std::cout << "] -> ";
+            leaf = leaf->next;
+        }
+        std::cout << "NULL\n";
+    }
+
+    // 遍历
+    void traverse() {
+        if (root) root->traverse();
+        else std::cout << "Empty tree\n";
+    }
+
+    // 统计快照：逐层遍历得到高度、各层节点数和填充分布，附带 BTREE_STATS 下的操作计数
+    TreeStats stats() const {
+        TreeStats s;
+        s.capacity = 2 * t;
+        std::vector<const BPlusNode<KeyType, ValueType, T>*> level, next;
+        if (root) level.push_back(root);
+        while (!level.empty()) {
+            s.nodesPerLevel.push_back(level.size());
+            next.clear();
+            for (auto node : level) {
+                s.addNode(node->keys.size(), node->blockSize() + bplusKeyHeapBytes(node->keys));
+                if (node->isLeaf) {
+                    s.keys += node->keys.size();
+                }
+                else {
+                    auto& children = static_cast<const BPlusInternalNode<KeyType, ValueType, T>*>(node)->children;
+                    next.insert(next.end(), children.begin(), children.end());
+                }
+            }
+            level.swap(next);
+        }
+        s.height = s.nodesPerLevel.size();
+#if BTREE_STATS
+        s.ops = opCounters;
+#endif
+        return s;
+    }
+
+    // 清零操作计数
+    void resetStats() {
+#if BTREE_STATS
+        opCounters = TreeOpCounters();
+#endif
+    }
+
+    // 按叶子链表顺序导出只读副本，之后对本树的修改不影响它
+    FrozenBPlusTree<KeyType, ValueType> freeze() const {
+        std::vector<KeyType> keys;
+        std::vector<ValueType> values;
+        BPlusNode<KeyType, ValueType, T>* cur = root;
+        while (cur && !cur->isLeaf)
+            cur = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur)->children.front();
+        for (auto leaf = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur); leaf; leaf = leaf->next) {
+            for (const auto& k : leaf->keys) keys.push_back(k);
+            if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue)
+                values.insert(values.end(), leaf->values.begin(), leaf->values.end());
+        }
+        return FrozenBPlusTree<KeyType, ValueType>(std::move(keys), std::move(values));
+    }
+
+    // 把树写成快照文件（格式见 BPlusSnapshotHeader）。先写 path.tmp 再改名，写失败不会破坏原文件
+    void save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                      "snapshots store keys and values as raw bytes");
+        constexpr bool hasValue = BPlusLeafNode<KeyType, ValueType, T>::hasValue;
+        // 从根逐层收集节点，写的时候从叶子层开始
+        std::vector<std::vector<const BPlusNode<KeyType, ValueType, T>*>> levels;
+        if (root) levels.push_back({ root });
+        while (!levels.empty() && !levels.back().front()->isLeaf) {
+            std::vector<const BPlusNode<KeyType, ValueType, T>*> next;
+            for (auto node : levels.back()) {
+                auto& children = static_cast<const BPlusInternalNode<KeyType, ValueType, T>*>(node)->children;
+                next.insert(next.end(), children.begin(), children.end());
+            }
+            levels.push_back(std::move(next));
+        }
+
+        std::string tmp = path + ".tmp";
+        std::FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) throw std::runtime_error("BPlusTree::save: cannot open " + tmp);
+        // 攒满 1MB 再写，校验和随写随算；每段都补齐到 8 字节，缓冲区长度总是 8 的倍数
+        std::vector<char> buf;
+        buf.reserve(1 << 20);
+        uint64_t sum = snapshotChecksumSeed;
+        bool ok = true;
+        auto flush = [&] {
+            sum = snapshotChecksum(sum, buf.data(), buf.size());
+            ok = ok && std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+            buf.clear();
+        };
+        auto put = [&](const void* p, size_t bytes) {
+            const char* c = static_cast<const char*>(p);
+            buf.insert(buf.end(), c, c + bytes);
+            buf.resize(nodeAlignUp(buf.size(), 8));
+            if (buf.size() >= (1 << 20)) flush();
+        };
+
+        BPlusSnapshotHeader h{};
+        std::memcpy(h.magic, bplusSnapshotMagic, sizeof(h.magic));
+        h.version = bplusSnapshotVersion;
+        h.keyBytes = sizeof(KeyType);
+        h.valueBytes = hasValue ? sizeof(ValueType) : 0;
+        h.levels = static_cast<uint32_t>(levels.size());
+        h.t = t;
+        h.count = size();
+        put(&h, sizeof(h));
+        for (size_t l = levels.size(); l-- > 0; ) {
+            uint64_t nodes = levels[l].size();
+            put(&nodes, sizeof(nodes));
+            for (auto node : levels[l]) {
+                uint64_t n = node->keys.size();
+                put(&n, sizeof(n));
+                if constexpr (std::is_same<BPlusKeyArray<KeyType>, NodeArray<KeyType>>::value) {
+                    put(node->keys.data(), n * sizeof(KeyType));
+                }
+                else {
+                    // 压缩的 key 数组先解码，快照格式不变
+                    std::vector<KeyType> keys(node->keys.begin(), node->keys.end());
+                    put(keys.data(), n * sizeof(KeyType));
+                }
+                if constexpr (hasValue) {
+                    if (node->isLeaf)
+                        put(static_cast<const BPlusLeafNode<KeyType, ValueType, T>*>(node)->values.data(),
+                            n * sizeof(ValueType));
+                }
+            }
+        }
+        flush();
+        ok = ok && std::fwrite(&sum, sizeof(sum), 1, f) == 1;
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("BPlusTree::save: cannot write " + path);
+        }
+    }
+
+    // 从 save 写出的快照重建，替换原有内容。文件 mmap 进来，校验后逐层创建节点、
+    // 整段拷贝 key/value，不逐个插入也不比较 key。运行时度数的树改用快照中的 t
+    void load(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("BPlusTree::load: cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(BPlusSnapshotHeader)) {
+            ::close(fd);
+            throw std::runtime_error("BPlusTree::load: bad snapshot " + path);
+        }
+        size_t bytes = st.st_size;
+        void* p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("BPlusTree::load: mmap failed");
+        madvise(p, bytes, MADV_SEQUENTIAL);
+        try {
+            loadSnapshot(static_cast<const char*>(p), bytes);
+        }
+        catch (...) {
+            munmap(p, bytes);
+            throw;
+        }
+        munmap(p, bytes);
+#else
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) throw std::runtime_error("BPlusTree::load: cannot open " + path);
+        std::vector<char> data;
+        char chunk[1 << 16];
+        for (size_t got; (got = std::fread(chunk, 1, sizeof(chunk), f)) > 0; )
+            data.insert(data.end(), chunk, chunk + got);
+        std::fclose(f);
+        loadSnapshot(data.data(), data.size());
+#endif
+    }
+
+private:
+    // 新节点从 alloc 分配。join / splitAt 在树之间搬的是整棵子树，节点仍归原来的分配器，
+    // 这些分配器记在 adopted 里随本树保活；分配器由几棵树共用时，这几棵树不能在不同线程中同时修改
+    std::shared_ptr<Alloc> alloc = std::make_shared<Alloc>();
+    std::vector<std::shared_ptr<Alloc>> adopted;
+#if BTREE_STATS
+    TreeOpCounters opCounters;
+#endif
+
+    // 一棵子树和它的层数（叶子为 1 层），root 为空表示空树
+    struct Piece {
+        BPlusNode<KeyType, ValueType, T>* root;
+        size_t height;
+    };
+
+    static size_t heightOf(BPlusNode<KeyType, ValueType, T>* node) {
+        size_t h = 0;
+        for (; node; ++h)
+            node = node->isLeaf ? nullptr : static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(node)->children.front();
+        return h;
+    }
+
+    // node 子树的最左（last 为 false）或最右叶子
+    static BPlusLeafNode<KeyType, ValueType, T>* edgeLeaf(BPlusNode<KeyType, ValueType, T>* node, bool last) {
+        while (!node->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(node);
+            node = last ? inode->children.back() : inode->children.front();
+        }
+        return static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(node);
+    }
+
+    // 记下 from 的节点可能来自的分配器；已没有未归还块的分配器不再需要保活
+    void adoptArenas(const BPlusTree& from) {
+        adopted.erase(std::remove_if(adopted.begin(), adopted.end(), [](auto& a) { return a->liveBlocks() == 0; }),
+                      adopted.end());
+        auto add = [&](const std::shared_ptr<Alloc>& a) {
+            if (a != alloc && a->liveBlocks() > 0 && std::find(adopted.begin(), adopted.end(), a) == adopted.end())
+                adopted.push_back(a);
+        };
+        add(from.alloc);
+        for (auto& a : from.adopted) add(a);
+    }
+
+    // 内部节点 node 只剩 [0, n) 个孩子后作为一块：没有孩子时释放，只剩一个孩子时换成该孩子
+    static Piece trimmedPiece(BPlusInternalNode<KeyType, ValueType, T>* node, size_t height) {
+        if (node->children.size() > 1) return { node, height };
+        BPlusNode<KeyType, ValueType, T>* only = node->children.empty() ? nullptr : node->children[0];
+        node->children.clear();
+        node->dispose();
+        if (!only) return { nullptr, 0 };
+        only->parent = nullptr;
+        return { only, height - 1 };
+    }
+
+    // 把 a、b 接成一棵树，a 的 key 都不大于 b 的 key。两者一样高时新建根；
+    // 否则矮的作为子树挂到高的最右（或最左）路径上同高度的位置，先借位/合并补足它，
+    // 再自下而上分裂溢出的路径节点，只动这一条路径
+    Piece joinPieces(Piece a, Piece b) {
+        if (!a.root) return b;
+        if (!b.root) return a;
+        auto aLast = edgeLeaf(a.root, true), bFirst = edgeLeaf(b.root, false);
+        aLast->next = bFirst;
+        bFirst->prev = aLast;
+        if (a.height == b.height) {
+            auto s = BPlusInternalNode<KeyType, ValueType, T>::create(alloc.get(), t);
+            for (auto c : { a.root, b.root }) {
+                c->parent = s;
+                s->keys.push_back(c->keys.back());
+                s->children.push_back(c);
+                s->counts.push_back(BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(c));
+            }
+            // 两个旧根都可能不足 t 个，逐个借到 t 个，借不到时合并成一个
+            for (size_t i : { 1, 0 })
+                while (s->children.size() == 2 && s->children[i]->keys.size() < t) s->fill(i);
+            return trimmedPiece(s, a.height + 1);
+        }
+
+        bool toRight = a.height > b.height;
+        Piece host = toRight ? a : b;
+        BPlusNode<KeyType, ValueType, T>* sub = toRight ? b.root : a.root;
+        size_t subHeight = toRight ? b.height : a.height;
+        std::vector<BPlusInternalNode<KeyType, ValueType, T>*> spine;
+        BPlusNode<KeyType, ValueType, T>* cur = host.root;
+        for (size_t h = host.height; h > subHeight; --h) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            spine.push_back(inode);
+            cur = toRight ? inode->children.back() : inode->children.front();
+        }
+        size_t n = BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(sub);
+        auto s = spine.back();
+        sub->parent = s;
+        if (toRight) {
+            s->keys.push_back(sub->keys.back());
+            s->children.push_back(sub);
+            s->counts.push_back(n);
+            // 上面各层的最大 key 变为 sub 的最大 key
+            for (size_t d = 0; d + 1 < spine.size(); ++d) {
+                spine[d]->keys.set(spine[d]->keys.size() - 1, sub->keys.back());
+                spine[d]->counts.back() += n;
+            }
+        }
+        else {
+            s->keys.insert(s->keys.begin(), sub->keys.back());
+            s->children.insert(s->children.begin(), sub);
+            s->counts.insert(s->counts.begin(), n);
+            for (size_t d = 0; d + 1 < spine.size(); ++d) spine[d]->counts.front() += n;
+        }
+        size_t idx = toRight ? s->children.size() - 1 : 0;
+        while (s->children[idx]->keys.size() < t) {
+            size_t before = s->children.size();
+            s->fill(idx);
+            if (s->children.size() < before) break;
+        }
+        for (size_t d = spine.size(); d-- > 0 && spine[d]->keys.size() > 2 * t; ) {
+            if (d > 0) {
+                spine[d - 1]->splitChild(toRight ? spine[d - 1]->children.size() - 1 : 0);
+                continue;
+            }
+            auto r = BPlusInternalNode<KeyType, ValueType, T>::create(alloc.get(), t);
+            r->keys.push_back(spine[0]->keys.back());
+            r->children.push_back(spine[0]);
+            r->counts.push_back(BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(spine[0]));
+            spine[0]->parent = r;
+            r->splitChild(0);
+            host = { r, host.height + 1 };
+        }
+        return host;
+    }
+
+    // 以 k 为界切开子树 p，返回 (< k 的部分, >= k 的部分)。沿 k 的查找路径把每个节点一分为二，
+    // 路径左右两侧的整棵子树原样保留，再从叶子往上依次与更高一层的左右块 join
+    std::pair<Piece, Piece> splitPieces(Piece p, const KeyType& k) {
+        if (!p.root) return { p, p };
+        std::vector<std::pair<BPlusInternalNode<KeyType, ValueType, T>*, size_t>> path;
+        BPlusNode<KeyType, ValueType, T>* cur = p.root;
+        while (!cur->isLeaf) {
+            auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(cur);
+            size_t idx = std::min(inode->findKey(k), inode->keys.size() - 1);
+            path.emplace_back(inode, idx);
+            cur = inode->children[idx];
+        }
+        auto leaf = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(cur);
+        size_t pos = leaf->findKey(k);
+        BPlusLeafNode<KeyType, ValueType, T>* right = pos == 0 ? leaf : nullptr;
+        if (pos > 0 && pos < leaf->keys.size()) {
+            right = BPlusLeafNode<KeyType, ValueType, T>::create(leaf->alloc, t);
+            right->keys.assign(leaf->keys.begin() + pos, leaf->keys.end());
+            leaf->keys.resize(pos);
+            if constexpr (BPlusLeafNode<KeyType, ValueType, T>::hasValue) {
+                right->values.assign(std::make_move_iterator(leaf->values.begin() + pos),
+                                     std::make_move_iterator(leaf->values.end()));
+                leaf->values.resize(pos);
+            }
+            right->next = leaf->next;
+            if (leaf->next) leaf->next->prev = right;
+            leaf->next = right;
+            right->prev = leaf;
+        }
+        // 在左右两部分之间剪断叶子链表
+        auto leftEnd = pos > 0 ? leaf : leaf->prev;
+        if (leftEnd) {
+            if (leftEnd->next) leftEnd->next->prev = nullptr;
+            leftEnd->next = nullptr;
+        }
+
+        Piece lo{ pos > 0 ? leaf : nullptr, 1 }, hi{ right, 1 };
+        size_t h = 1;
+        for (size_t d = path.size(); d-- > 0; ) {
+            ++h;
+            auto inode = path[d].first;
+            size_t idx = path[d].second;
+            // idx 右边的孩子移到新节点，左边的留在 inode，children[idx] 已经切进了 lo / hi
+            Piece rest{ nullptr, 0 };
+            if (idx + 1 < inode->children.size()) {
+                auto r = BPlusInternalNode<KeyType, ValueType, T>::create(inode->alloc, t);
+                r->keys.assign(inode->keys.begin() + idx + 1, inode->keys.end());
+                r->children.assign(inode->children.begin() + idx + 1, inode->children.end());
+                r->counts.assign(inode->counts.begin() + idx + 1, inode->counts.end());
+                for (auto c : r->children) c->parent = r;
+                rest = trimmedPiece(r, h);
+            }
+            inode->keys.resize(idx);
+            inode->children.resize(idx);
+            inode->counts.resize(idx);
+            lo = joinPieces(trimmedPiece(inode, h), lo);
+            hi = joinPieces(hi, rest);
+        }
+        if (lo.root) lo.root->parent = nullptr;
+        if (hi.root) hi.root->parent = nullptr;
+        return { lo, hi };
+    }
+
+    // 解析并重建快照。先校验头部、校验和，再不建节点走一遍检查结构，最后才清空本树并建节点
+    void loadSnapshot(const char* data, size_t bytes) {
+        static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                      "snapshots store keys and values as raw bytes");
+        static_assert(alignof(KeyType) <= 8 && alignof(ValueType) <= 8, "snapshot sections are 8-byte aligned");
+        constexpr bool hasValue = BPlusLeafNode<KeyType, ValueType, T>::hasValue;
+        auto corrupt = [] { return std::runtime_error("BPlusTree::load: corrupt snapshot"); };
+        auto readU64 = [&](size_t pos) {
+            uint64_t v;
+            std::memcpy(&v, data + pos, sizeof(v));
+            return v;
+        };
+
+        BPlusSnapshotHeader h;
+        if (bytes < sizeof(h) + 8 || bytes % 8 != 0) throw corrupt();
+        std::memcpy(&h, data, sizeof(h));
+        if (std::memcmp(h.magic, bplusSnapshotMagic, sizeof(h.magic)) != 0 || h.version != bplusSnapshotVersion)
+            throw std::runtime_error("BPlusTree::load: not a snapshot of this version");
+        if (h.keyBytes != sizeof(KeyType) || h.valueBytes != (hasValue ? sizeof(ValueType) : 0))
+            throw std::runtime_error("BPlusTree::load: key/value size mismatch");
+        if (T != 0 && h.t != T) throw std::runtime_error("BPlusTree::load: degree mismatch");
+        if (h.t < 2 || h.t > (1u << 20)) throw corrupt();
+        size_t end = bytes - 8;
+        if (snapshotChecksum(snapshotChecksumSeed, data, end) != readU64(end))
+            throw std::runtime_error("BPlusTree::load: checksum mismatch");
+
+        // 结构检查：叶子 key 总数等于 count，每层 key 总数（即孩子总数）等于下一层的节点数，根层只有一个节点
+        size_t pos = sizeof(h), below = 0;
+        for (uint32_t l = 0; l < h.levels; ++l) {
+            if (pos + 8 > end) throw corrupt();
+            uint64_t nodes = readU64(pos);
+            pos += 8;
+            uint64_t total = 0;
+            for (uint64_t i = 0; i < nodes; ++i) {
+                if (pos + 8 > end) throw corrupt();
+                uint64_t n = readU64(pos);
+                pos += 8;
+                if (n == 0 || n > 2 * h.t + 1) throw corrupt();
+                pos += nodeAlignUp(n * sizeof(KeyType), 8);
+                if (hasValue && l == 0) pos += nodeAlignUp(n * sizeof(ValueType), 8);
+                if (pos > end) throw corrupt();
+                total += n;
+            }
+            if (l == 0 ? total != h.count : total != below) throw corrupt();
+            below = nodes;
+        }
+        if (pos != end || (h.levels == 0 ? h.count != 0 : below != 1)) throw corrupt();
+
+        clear();
+        if constexpr (T == 0) this->t = h.t;
+        // 建到一半内存不足时，逐个归还已建的节点
+        std::vector<BPlusNode<KeyType, ValueType, T>*> created, level, next;
+        try {
+            pos = sizeof(h);
+            BPlusLeafNode<KeyType, ValueType, T>* prevLeaf = nullptr;
+            for (uint32_t l = 0; l < h.levels; ++l) {
+                uint64_t nodes = readU64(pos);
+                pos += 8;
+                next.clear();
+                next.reserve(nodes);
+                size_t c = 0;
+                for (uint64_t i = 0; i < nodes; ++i) {
+                    uint64_t n = readU64(pos);
+                    pos += 8;
+                    const KeyType* keys = reinterpret_cast<const KeyType*>(data + pos);
+                    pos += nodeAlignUp(n * sizeof(KeyType), 8);
+                    if (l == 0) {
+                        auto leaf = BPlusLeafNode<KeyType, ValueType, T>::create(alloc.get(), t);
+                        created.push_back(leaf);
+                        leaf->keys.assign(keys, keys + n);
+                        if constexpr (hasValue) {
+                            const ValueType* values = reinterpret_cast<const ValueType*>(data + pos);
+                            pos += nodeAlignUp(n * sizeof(ValueType), 8);
+                            leaf->values.assign(values, values + n);
+                        }
+                        leaf->prev = prevLeaf;
+                        if (prevLeaf) prevLeaf->next = leaf;
+                        prevLeaf = leaf;
+                        next.push_back(leaf);
+                    }
+                    else {
+                        auto node = BPlusInternalNode<KeyType, ValueType, T>::create(alloc.get(), t);
+                        created.push_back(node);
+                        node->keys.assign(keys, keys + n);
+                        for (uint64_t j = 0; j < n; ++j, ++c) {
+                            level[c]->parent = node;
+                            node->children.push_back(level[c]);
+                            node->counts.push_back(BPlusInternalNode<KeyType, ValueType, T>::subtreeCount(level[c]));
+                        }
+                        next.push_back(node);
+                    }
+                }
+                level.swap(next);
+            }
+        }
+        catch (...) {
+            for (auto node : created) node->dispose();
+            throw;
+        }
+        root = level.empty() ? nullptr : level[0];
+    }
+
+    // 批量下降：先按 key 排序，再逐层处理。同一层所有待访问节点一起处理，
+    // 落到同一孩子的一段 key 只访问该孩子一次；生成下一层列表时就预取孩子节点，
+    // 处理到它时数据多半已在缓存中。对每个命中的 key 调用 visit(i, leaf, idx)
+    template<typename Visit>
+    void lookupBatch(const KeyType* keys, size_t n, Visit&& visit) {
+        if (!root || n == 0) return;
+        // 排序 (key, 原下标) 对，比按下标间接比较更省缓存
+        std::vector<std::pair<KeyType, size_t>> sorted(n);
+        for (size_t i = 0; i < n; ++i) sorted[i] = { keys[i], i };
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // sorted[lo, hi) 这段 key 都要在 node 中继续查找
+        struct Pending {
+            BPlusNode<KeyType, ValueType, T>* node;
+            size_t lo, hi;
+        };
+        std::vector<Pending> level{ { root, 0, n } }, next;
+        while (!level.front().node->isLeaf) {
+            next.clear();
+            for (const Pending& p : level) {
+                auto inode = static_cast<BPlusInternalNode<KeyType, ValueType, T>*>(p.node);
+                size_t i = p.lo;
+                while (i < p.hi) {
+                    size_t idx = inode->findKey(sorted[i].first);
+                    // 剩下的 key 都比本节点最大 key 大，不存在
+                    if (idx == inode->keys.size()) break;
+                    const KeyType& sep = inode->keys[idx];
+                    size_t j = i + 1;
+                    while (j < p.hi && !(sep < sorted[j].first)) ++j;
+                    auto child = inode->children[idx];
+                    // 节点头和 keys 开头在同一块内存的前几行
+                    BPLUS_PREFETCH(child);
+                    BPLUS_PREFETCH(reinterpret_cast<const char*>(child) + 64);
+                    BPLUS_PREFETCH(reinterpret_cast<const char*>(child) + 128);
+                    next.push_back({ child, i, j });
+                    i = j;
+                }
+            }
+            if (next.empty()) return;
+            level.swap(next);
+        }
+        for (const Pending& p : level) {
+            auto leaf = static_cast<BPlusLeafNode<KeyType, ValueType, T>*>(p.node);
+            // key 有序，叶内位置单调不减
+            size_t pos = 0;
+            for (size_t i = p.lo; i < p.hi; ++i) {
+                const KeyType& k = sorted[i].first;
+                pos = bplusLowerBound(leaf->keys, k, pos);
+                if (pos < leaf->keys.size() && leaf->keyEquals(pos, k))
+                    visit(sorted[i].second, leaf, pos);
+            }
+        }
+    }
+};
+
+// 最小度数在编译期给定的 B+ 树：节点不存 t，容量和节点大小都是常量
+template<typename KeyType, size_t T, typename ValueType = BPlusNoValue, typename Alloc = SlabArena>
+using FixedBPlusTree = BPlusTree<KeyType, ValueType, Alloc, T>;
+
+// 节点内整数 key 按差值压缩存放的 B+ 树，接口与 BPlusTree<Int> 相同，迭代器解引用得到 PackedInt<Int>
+template<typename Int, typename ValueType = BPlusNoValue, typename Alloc = SlabArena, size_t T = 0>
+using PackedBPlusTree = BPlusTree<PackedInt<Int>, ValueType, Alloc, T>;
+
+// 叶子和内部节点都不超过 Lines 条缓存行时的最大度数（至少为 2），如 FixedBPlusTree<Key, bplusDegreeFor<Key>()>
+template<typename KeyType, typename ValueType = BPlusNoValue, size_t Lines = 8>
+constexpr size_t bplusDegreeFor() {
+    size_t t = 2;
+    while (std::max(BPlusLeafNode<KeyType, ValueType, 2>::bytesFor(t + 1),
+                    BPlusInternalNode<KeyType, ValueType, 2>::bytesFor(t + 1)) <= Lines * cacheLineBytes)
+        ++t;
+    return t;
+}
+
+// 一个 key 的全部 id，升序且不重复，作为 BPlusMultiMap 叶子中的 value。
+// id 存与前一个的差值，按每字节 7 位变长编码，写在一串页里；每页的首个 id 存原值，
+// 页之间互不依赖，乱序插入和删除只需解码、重编一页。页从 64 字节起按 2 倍增长到 4KB：
+// 只出现几次的 key 只占一个小页，高频 key 按升序追加时只写尾页
+template<typename Id = uint64_t>
+class PostingList {
+    static_assert(std::is_unsigned<Id>::value, "posting ids must be unsigned integers");
+    struct Page;
+public:
+    static constexpr uint32_t minPageBytes = 64;
+    static constexpr uint32_t maxPageBytes = 4096;
+
+    PostingList() = default;
+    PostingList(const PostingList& o) : n(o.n) {
+        Page** link = &head;
+        for (const Page* pg = o.head; pg; pg = pg->next) {
+            Page* copy = static_cast<Page*>(::operator new(sizeof(Page) + pg->cap));
+            std::memcpy(static_cast<void*>(copy), pg, sizeof(Page) + pg->used);
+            *link = tail = copy;
+            link = &copy->next;
+        }
+        *link = nullptr;
+    }
+    PostingList(PostingList&& o) noexcept : head(o.head), tail(o.tail), n(o.n) {
+        o.head = o.tail = nullptr;
+        o.n = 0;
+    }
+    PostingList& operator=(PostingList o) noexcept {
+        std::swap(head, o.head);
+        std::swap(tail, o.tail);
+        std::swap(n, o.n);
+        return *this;
+    }
+    ~PostingList() {
+        while (head) {
+            Page* next = head->next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+
+    // 按 id 升序解码
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Id;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Id*;
+        using reference = const Id&;
+
+        const_iterator() = default;
+        explicit const_iterator(const Page* p) { enter(p); }
+        reference operator*() const { return cur; }
+        const_iterator& operator++() {
+            if (idx < pg->count) {
+                Id d;
+                pos = getVarint(pos, d);
+                cur += d;
+                ++idx;
+            }
+            else {
+                enter(pg->next);
+            }
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const const_iterator& o) const { return pg == o.pg && idx == o.idx; }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+    private:
+        const Page* pg = nullptr;
+        const unsigned char* pos = nullptr;
+        uint32_t idx = 0;  // 本页已读出的 id 数
+        Id cur = 0;
+        void enter(const Page* p) {
+            pg = p;
+            idx = p ? 1 : 0;
+            if (p) {
+                cur = p->first;
+                pos = p->data();
+            }
+        }
+    };
+
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(); }
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    Id front() const { return head->first; }
+    Id back() const { return tail->last; }
+
+    // 各页占用的字节数，含页头
+    size_t bytes() const {
+        size_t b = 0;
+        for (const Page* pg = head; pg; pg = pg->next) b += sizeof(Page) + pg->cap;
+        return b;
+    }
+
+    // 加入 id，已存在时返回 false。比现有 id 都大时直接追加到尾页，尾页满了再接一页
+    bool add(Id id) {
+        if (!tail) {
+            head = tail = newPage(minPageBytes, id);
+            ++n;
+            return true;
+        }
+        if (tail->last < id) {
+            Id d = id - tail->last;
+            size_t b = varintBytes(d);
+            if (tail->used + b <= tail->cap) {
+                putVarint(tail->data() + tail->used, d);
+                tail->used += b;
+                tail->last = id;
+                tail->count++;
+            }
+            else {
+                uint32_t bytes = std::min<uint32_t>(maxPageBytes, 2 * (sizeof(Page) + tail->cap));
+                tail->next = newPage(bytes, id);
+                tail = tail->next;
+            }
+            ++n;
+            return true;
+        }
+        Page* prev = nullptr;
+        Page* pg = locate(id, prev);
+        std::vector<Id> ids = decode(pg);
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (*it == id) return false;
+        ids.insert(it, id);
+        rewrite(prev, pg, ids);
+        ++n;
+        return true;
+    }
+
+    // 删除 id，不存在时返回 false；页空了就摘掉
+    bool remove(Id id) {
+        if (!tail || tail->last < id) return false;
+        Page* prev = nullptr;
+        Page* pg = locate(id, prev);
+        if (id < pg->first) return false;
+        std::vector<Id> ids = decode(pg);
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (*it != id) return false;
+        ids.erase(it);
+        rewrite(prev, pg, ids);
+        --n;
+        return true;
+    }
+
+    bool contains(Id id) const {
+        if (!tail || tail->last < id) return false;
+        const Page* pg = head;
+        while (pg->last < id) pg = pg->next;
+        for (auto it = const_iterator(pg); it != const_iterator(pg->next); ++it)
+            if (*it >= id) return *it == id;
+        return false;
+    }
+
+private:
+    // 页头之后是 cap 字节的变长差值
+    struct Page {
+        Page* next;
+        Id first, last;
+        uint32_t count;  // 本页 id 数，含 first
+        uint32_t used;
+        uint32_t cap;
+        unsigned char* data() { return reinterpret_cast<unsigned char*>(this + 1); }
+        const unsigned char* data() const { return reinterpret_cast<const unsigned char*>(this + 1); }
+    };
+
+    Page* head = nullptr;
+    Page* tail = nullptr;
+    size_t n = 0;
+
+    static Page* newPage(uint32_t bytes, Id first) {
+        void* p = ::operator new(bytes);
+        return new (p) Page{ nullptr, first, first, 1, 0, uint32_t(bytes - sizeof(Page)) };
+    }
+
+    static size_t varintBytes(Id v) {
+        size_t b = 1;
+        for (; v >= 0x80; v >>= 7) ++b;
+        return b;
+    }
+    static unsigned char* putVarint(unsigned char* p, Id v) {
+        for (; v >= 0x80; v >>= 7) *p++ = static_cast<unsigned char>(v) | 0x80;
+        *p++ = static_cast<unsigned char>(v);
+        return p;
+    }
+    static const unsigned char* getVarint(const unsigned char* p, Id& v) {
+        v = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            unsigned char b = *p++;
+            v |= Id(b & 0x7f) << shift;
+            if (!(b & 0x80)) return p;
+        }
+    }
+
+    // 第一个 last >= id 的页，调用前须确认 tail->last >= id；prev 为其前一页
+    Page* locate(Id id, Page*& prev) {
+        Page* pg = head;
+        while (pg->last < id) {
+            prev = pg;
+            pg = pg->next;
+        }
+        return pg;
+    }
+
+    static std::vector<Id> decode(const Page* pg) {
+        std::vector<Id> ids;
+        ids.reserve(pg->count);
+        for (auto it = const_iterator(pg); it != const_iterator(pg->next); ++it) ids.push_back(*it);
+        return ids;
+    }
+
+    // 用 ids 重写 pg：先写回 pg，放不下时接着开同样大小的页；ids 为空时摘掉 pg
+    void rewrite(Page* prev, Page* pg, const std::vector<Id>& ids) {
+        Page* after = pg->next;
+        uint32_t cap = pg->cap;
+        Page* last = nullptr;
+        for (size_t i = 0; i < ids.size(); ) {
+            Page* p = last ? newPage(sizeof(Page) + cap, ids[i]) : new (pg) Page{ nullptr, ids[i], ids[i], 1, 0, cap };
+            for (++i; i < ids.size(); ++i) {
+                Id d = ids[i] - p->last;
+                size_t b = varintBytes(d);
+                if (p->used + b > p->cap) break;
+                putVarint(p->data() + p->used, d);
+                p->used += b;
+                p->last = ids[i];
+                p->count++;
+            }
+            if (last) last->next = p;
+            last = p;
+        }
+        if (!last) {
+            ::operator delete(pg);
+            if (prev) prev->next = after;
+            else head = after;
+            if (tail == pg) tail = prev;
+            return;
+        }
+        last->next = after;
+        if (tail == pg) tail = last;
+    }
+};
+
+// 多值映射：一个 key 对应一组 id，如二级索引里 key 对应的行号。每个 key 在叶子中只占一项，
+// value 为该 key 的 PostingList，重复再多的 key 也只占一个槽位，不会因此引起叶子分裂
+template<typename KeyType, typename Id = uint64_t, typename Alloc = SlabArena>
+class BPlusMultiMap {
+public:
+    using Postings = PostingList<Id>;
+    using iterator = typename BPlusTree<KeyType, Postings, Alloc>::iterator;
+
+    explicit BPlusMultiMap(int t) : tree(t) {}
+
+    // 加入 (k, id)，已存在时返回 false。k 已存在时只下降一次
+    bool insert(const KeyType& k, Id id) {
+        if (Postings* p = tree.find(k)) {
+            bool added = p->add(id);
+            pairs += added;
+            return added;
+        }
+        Postings p;
+        p.add(id);
+        tree.emplace(k, std::move(p));
+        ++pairs;
+        return true;
+    }
+
+    // 删除 (k, id)，k 的最后一个 id 删掉后 k 也删除
+    bool erase(const KeyType& k, Id id) {
+        Postings* p = tree.find(k);
+        if (!p || !p->remove(id)) return false;
+        --pairs;
+        if (p->empty()) tree.erase(k);
+        return true;
+    }
+
+    // 删除 k 的全部 id，返回删除的个数
+    size_t erase(const KeyType& k) {
+        Postings* p = tree.find(k);
+        if (!p) return 0;
+        size_t n = p->size();
+        tree.erase(k);
+        pairs -= n;
+        return n;
+    }
+
+    // k 的全部 id，可按升序迭代；k 不存在时为 nullptr
+    const Postings* find(const KeyType& k) { return tree.find(k); }
+    size_t count(const KeyType& k) {
+        const Postings* p = find(k);
+        return p ? p->size() : 0;
+    }
+
+    // (key, id) 对的个数和不同 key 的个数
+    size_t size() const { return pairs; }
+    size_t keyCount() const { return tree.size(); }
+
+    // 按 key 升序遍历，it.key() 为 key，it.value() 为其 PostingList
+    iterator begin() { return tree.begin(); }
+    iterator end() { return tree.end(); }
+    BPlusRange<iterator> range(const KeyType& lo, const KeyType& hi) { return tree.range(lo, hi); }
+
+    // 树节点的统计，PostingList 的页不在其中
+    TreeStats stats() const { return tree.stats(); }
+
+private:
+    BPlusTree<KeyType, Postings, Alloc> tree;
+    size_t pairs = 0;
+};
+
+// 基于 epoch 的延迟回收：节点被合并后可能仍有读者持有指针，
+// 等所有进入过旧 epoch 的线程都离开后再释放。
+// 每个线程只写自己独占缓存行里的 slot，读者之间不共享写
+class EpochManager {
+public:
+    static constexpr size_t kMaxThreads = 256;
+    static constexpr size_t kMaxHandles = 256;
+
+    // 作用域内的线程处于临界区，期间读到的节点不会被释放
+    class Guard {
+    public:
+        explicit Guard(std::atomic<uint64_t>* _epoch) : epoch(_epoch) {}
+        ~Guard() { release(); }
+        Guard(Guard&& o) noexcept : epoch(o.epoch) { o.epoch = nullptr; }
+        Guard& operator=(Guard&& o) noexcept {
+            if (this != &o) {
+                release();
+                epoch = o.epoch;
+                o.epoch = nullptr;
+            }
+            return *this;
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    private:
+        std::atomic<uint64_t>* epoch;  // 所占 slot 的 epoch
+
+        void release() {
+            if (epoch) epoch->store(0, std::memory_order_release);
+        }
+    };
+
+    EpochManager() : globalEpoch(1) {
+        for (auto& s : slots) s.epoch.store(0, std::memory_order_relaxed);
+        for (auto& s : handles) s.epoch.store(0, std::memory_order_relaxed);
+    }
+    ~EpochManager() {
+        for (auto& r : retired) r.deleter(r.ptr);
+    }
+
+    // 占用本线程的 slot，不可嵌套，须在本线程上释放
+    Guard pin() {
+        size_t s = threadSlot();
+        slots[s].epoch.store(globalEpoch.load());
+        return Guard(&slots[s].epoch);
+    }
+
+    // 不绑定线程的 pin：占用一个空闲的 handle slot，可以嵌套、跨线程移动和释放，
+    // 用于长期持有的快照。同一线程先后拿到的 handle 各记各的 epoch，释放旧的不必等新的
+    Guard hold() {
+        size_t start = threadSlot();
+        for (size_t i = 0; i < kMaxHandles; ++i) {
+            Slot& s = handles[(start + i) % kMaxHandles];
+            uint64_t expected = 0;
+            if (s.epoch.compare_exchange_strong(expected, globalEpoch.load())) return Guard(&s.epoch);
+        }
+        throw std::runtime_error("EpochManager: too many handles");
+    }
+
+    // 节点已从树上摘下，登记为待回收
+    void retire(void* p, void (*deleter)(void*)) {
+        std::lock_guard<std::mutex> lock(retireMutex);
+        retired.push_back({ globalEpoch.load(), p, deleter });
+        // 有读者长期停在旧 epoch 时 retired 里积压的节点回收不了，攒够新的 64 个再扫一次
+        if (retired.size() >= reclaimAt) {
+            globalEpoch.fetch_add(1);
+            reclaim();
+            reclaimAt = retired.size() + 64;
+        }
+    }
+
+    // 宽限期：推进 epoch 并等到调用前已进入临界区的线程和 handle 都离开。
+    // 返回后再 pin 的读者一定能看到调用前发布的指针，旧指针可直接释放
+    void synchronize() {
+        uint64_t e = globalEpoch.fetch_add(1) + 1;
+        auto drain = [e](Slot& s) {
+            for (uint64_t v = s.epoch.load(); v != 0 && v < e; v = s.epoch.load()) std::this_thread::yield();
+        };
+        for (auto& s : slots) drain(s);
+        for (auto& s : handles) drain(s);
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch;  // 0 表示不在临界区
+    };
+    struct Retired {
+        uint64_t epoch;
+        void* ptr;
+        void (*deleter)(void*);
+    };
+
+    std::atomic<uint64_t> globalEpoch;
+    Slot slots[kMaxThreads];
+    Slot handles[kMaxHandles];
+    std::mutex retireMutex;
+    std::vector<Retired> retired;  // 按 epoch 升序
+    size_t reclaimAt = 64;
+
+    // 释放比所有活跃线程和 handle 的 epoch 都早的节点
+    void reclaim() {
+        uint64_t minActive = UINT64_MAX;
+        for (auto& s : slots) {
+            uint64_t e = s.epoch.load();
+            if (e != 0) minActive = std::min(minActive, e);
+        }
+        for (auto& s : handles) {
+            uint64_t e = s.epoch.load();
+            if (e != 0) minActive = std::min(minActive, e);
+        }
+        size_t n = 0;
+        while (n < retired.size() && retired[n].epoch < minActive) {
+            retired[n].deleter(retired[n].ptr);
+            ++n;
+        }
+        retired.erase(retired.begin(), retired.begin() + n);
+    }
+
+    // 线程第一次使用时分配一个 slot，线程退出时归还；所有 EpochManager 共用编号
+    static size_t threadSlot() {
+        struct Holder {
+            size_t id;
+            Holder() : id(acquire()) {}
+            ~Holder() { used()[id].store(false); }
+        };
+        thread_local Holder holder;
+        return holder.id;
+    }
+    static std::atomic<bool>* used() {
+        static std::atomic<bool> flags[kMaxThreads];
+        return flags;
+    }
+    static size_t acquire() {
+        for (size_t i = 0; i < kMaxThreads; ++i) {
+            bool expected = false;
+            if (used()[i].compare_exchange_strong(expected, true)) return i;
+        }
+        throw std::runtime_error("EpochManager: too many threads");
+    }
+};
+
+// 乐观锁耦合（optimistic lock coupling）的节点：version 的 bit1 为写锁，bit0 为废弃标记，
+// 其余位为计数。读者只读 version、不加锁，读完后校验 version 未变，否则重来
+template<typename KeyType, typename ValueType>
+class OLCNode {
+public:
+    std::atomic<uint64_t> version;
+    bool isLeaf;
+    NodeArray<KeyType> keys;
+    OLCNode(size_t cap, bool leaf) : version(0b100), isLeaf(leaf), keys(cap) {}
+    virtual ~OLCNode() = default;
+
+    static bool isLocked(uint64_t v) { return (v & 0b10) == 0b10; }
+    static bool isObsolete(uint64_t v) { return (v & 1) == 1; }
+
+    // 等待写锁释放后返回 version；节点已废弃则需要重来
+    uint64_t readLockOrRestart(bool& needRestart) const {
+        uint64_t v = version.load(std::memory_order_acquire);
+        while (isLocked(v)) {
+#if defined(__SSE2__)
+            _mm_pause();
+#endif
+            v = version.load(std::memory_order_acquire);
+        }
+        if (isObsolete(v)) needRestart = true;
+        return v;
+    }
+
+    // 读完节点内容后校验
+    void readUnlockOrRestart(uint64_t v, bool& needRestart) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (v != version.load(std::memory_order_relaxed)) needRestart = true;
+    }
+
+    void upgradeToWriteLockOrRestart(uint64_t& v, bool& needRestart) {
+        if (version.compare_exchange_strong(v, v + 0b10)) v += 0b10;
+        else needRestart = true;
+    }
+
+    // 不自旋等待：已被锁住就直接重来
+    void tryWriteLockOrRestart(bool& needRestart) {
+        uint64_t v = version.load();
+        if (isLocked(v) || isObsolete(v)) {
+            needRestart = true;
+            return;
+        }
+        upgradeToWriteLockOrRestart(v, needRestart);
+    }
+
+    void writeUnlock() { version.fetch_add(0b10); }
+    void writeUnlockObsolete() { version.fetch_add(0b11); }
+
+    size_t findKey(const KeyType& k) const {
+        return nodeLowerBound(keys.data(), keys.size(), k);
+    }
+};
+
+template<typename KeyType, typename ValueType>
+class OLCLeafNode : public OLCNode<KeyType, ValueType> {
+public:
+    NodeArray<ValueType> values;
+    OLCLeafNode(size_t cap) : OLCNode<KeyType, ValueType>(cap, true), values(cap) {}
+};
+
+// children 比 keys 多一个：children[i] 中的 key 都 <= keys[i] < children[i+1] 中的 key
+template<typename KeyType, typename ValueType>
+class OLCInternalNode : public OLCNode<KeyType, ValueType> {
+public:
+    NodeArray<OLCNode<KeyType, ValueType>*> children;
+    OLCInternalNode(size_t cap) : OLCNode<KeyType, ValueType>(cap, false), children(cap + 1) {}
+};
+
+// 线程安全的 B+ 树：查找全程不写共享内存，写者只锁叶子；
+// 分裂在下降途中提前进行（同 BTreeNode::insertNonFull），只锁父节点和被分裂的节点；
+// 删除途中遇到不足 t 个 key 的孩子时像 fill 一样借或合并，只锁父节点、孩子和兄弟。
+// 路径由下降过程记录，不维护 parent 指针。
+// 读者会读到正在修改的节点再校验 version，因此 key 和 value 必须可平凡拷贝
+template<typename KeyType, typename ValueType>
+class ConcurrentBPlusTree {
+    static_assert(std::is_trivially_copyable<KeyType>::value, "OLC requires trivially copyable keys");
+    static_assert(std::is_trivially_copyable<ValueType>::value, "OLC requires trivially copyable values");
+public:
+    using Node = OLCNode<KeyType, ValueType>;
+    using Leaf = OLCLeafNode<KeyType, ValueType>;
+    using Internal = OLCInternalNode<KeyType, ValueType>;
+
+    ConcurrentBPlusTree(int _t) : t(_t), cap(2 * _t), root(new Leaf(2 * _t)) {}
+    ~ConcurrentBPlusTree() { destroy(root.load()); }
+    ConcurrentBPlusTree(const ConcurrentBPlusTree&) = delete;
+    ConcurrentBPlusTree& operator=(const ConcurrentBPlusTree&) = delete;
+
+    // 找到 k 时把 value 拷到 out
+    bool find(const KeyType& k, ValueType& out) {
+        auto guard = epoch.pin();
+        for (;;) {
+            bool needRestart = false;
+            Node* node = root.load();
+            uint64_t v = node->readLockOrRestart(needRestart);
+            if (needRestart || node != root.load()) continue;
+            while (!node->isLeaf) {
+                auto inner = static_cast<Internal*>(node);
+                Node* child = inner->children[inner->findKey(k)];
+                // 访问 child 前先确认读到的指针有效
+                inner->readUnlockOrRestart(v, needRestart);
+                if (needRestart) break;
+                uint64_t vChild = child->readLockOrRestart(needRestart);
+                if (needRestart) break;
+                // 拿到 child 的 version 后再校验一次父节点，排除这之间 child 被分裂或合并
+                inner->readUnlockOrRestart(v, needRestart);
+                if (needRestart) break;
+                node = child;
+                v = vChild;
+            }
+            if (needRestart) continue;
+            auto leaf = static_cast<Leaf*>(node);
+            size_t idx = leaf->findKey(k);
+            bool found = idx < leaf->keys.size() && leaf->keys[idx] == k;
+            ValueType val = found ? leaf->values[idx] : ValueType();
+            leaf->readUnlockOrRestart(v, needRestart);
+            if (needRestart) continue;
+            if (found) out = val;
+            return found;
+        }
+    }
+
+    // k 不存在则插入，存在则覆盖；返回是否新插入
+    bool insert_or_assign(const KeyType& k, const ValueType& val) {
+        auto guard = epoch.pin();
+        for (;;) {
+            int r = tryInsert(k, val);
+            if (r >= 0) return r == 1;
+        }
+    }
+
+    // 返回 k 是否存在
+    bool erase(const KeyType& k) {
+        auto guard = epoch.pin();
+        for (;;) {
+            int r = tryErase(k);
+            if (r >= 0) return r == 1;
+        }
+    }
+
+private:
+    size_t t;
+    size_t cap;  // 每个节点最多 2t 个 key
+    std::atomic<Node*> root;
+    EpochManager epoch;
+
+    static void deleteNode(void* p) { delete static_cast<Node*>(p); }
+
+    static void destroy(Node* node) {
+        if (!node->isLeaf) {
+            for (auto child : static_cast<Internal*>(node)->children)
+                destroy(child);
+        }
+        delete node;
+    }
+
+    // 把已加写锁的满节点分成两半，返回右半和分隔 key（左半的最大 key）
+    Node* split(Node* node, KeyType& sep) {
+        size_t n = node->keys.size();
+        if (node->isLeaf) {
+            auto left = static_cast<Leaf*>(node);
+            auto right = new Leaf(cap);
+            size_t mid = n / 2;
+            right->keys.assign(left->keys.begin() + mid, left->keys.end());
+            right->values.assign(left->values.begin() + mid, left->values.end());
+            left->keys.resize(mid);
+            left->values.resize(mid);
+            sep = left->keys.back();
+            return right;
+        }
+        auto left = static_cast<Internal*>(node);
+        auto right = new Internal(cap);
+        size_t mid = n / 2;
+        sep = left->keys[mid];
+        right->keys.assign(left->keys.begin() + mid + 1, left->keys.end());
+        right->children.assign(left->children.begin() + mid + 1, left->children.end());
+        left->keys.resize(mid);
+        left->children.resize(mid + 1);
+        return right;
+    }
+
+    // 已加写锁的 node 分裂并把分隔 key 挂到同样已加锁的父节点上，parent 为空时 node 为根
+    void splitAndLink(Internal* parent, Node* node, const KeyType& k) {
+        KeyType sep;
+        Node* right = split(node, sep);
+        if (parent) {
+            size_t pos = parent->findKey(k);
+            parent->keys.insert(parent->keys.begin() + pos, sep);
+            parent->children.insert(parent->children.begin() + pos + 1, right);
+        }
+        else {
+            auto newRoot = new Internal(cap);
+            newRoot->keys.push_back(sep);
+            newRoot->children.push_back(node);
+            newRoot->children.push_back(right);
+            root.store(newRoot);
+        }
+    }
+
+    // 返回 1 新插入，0 已存在并覆盖，-1 需要重来
+    int tryInsert(const KeyType& k, const ValueType& val) {
+        bool needRestart = false;
+        Node* node = root.load();
+        uint64_t v = node->readLockOrRestart(needRestart);
+        if (needRestart || node != root.load()) return -1;
+        Internal* parent = nullptr;
+        uint64_t vParent = 0;
+
+        for (;;) {
+            // 满节点提前分裂，保证之后父节点总有空位容纳新的分隔 key
+            if (node->keys.size() == cap) {
+                if (parent) {
+                    parent->upgradeToWriteLockOrRestart(vParent, needRestart);
+                    if (needRestart) return -1;
+                }
+                node->upgradeToWriteLockOrRestart(v, needRestart);
+                if (needRestart) {
+                    if (parent) parent->writeUnlock();
+                    return -1;
+                }
+                if (parent || node == root.load())
+                    splitAndLink(parent, node, k);
+                node->writeUnlock();
+                if (parent) parent->writeUnlock();
+                return -1;
+            }
+            if (node->isLeaf) break;
+
+            auto inner = static_cast<Internal*>(node);
+            if (parent) {
+                parent->readUnlockOrRestart(vParent, needRestart);
+                if (needRestart) return -1;
+            }
+            Node* child = inner->children[inner->findKey(k)];
+            inner->readUnlockOrRestart(v, needRestart);
+            if (needRestart) return -1;
+            uint64_t vChild = child->readLockOrRestart(needRestart);
+            if (needRestart) return -1;
+            parent = inner;
+            vParent = v;
+            node = child;
+            v = vChild;
+        }
+
+        // 只锁叶子
+        auto leaf = static_cast<Leaf*>(node);
+        leaf->upgradeToWriteLockOrRestart(v, needRestart);
+        if (needRestart) return -1;
+        if (parent) {
+            parent->readUnlockOrRestart(vParent, needRestart);
+            if (needRestart) {
+                leaf->writeUnlock();
+                return -1;
+            }
+        }
+        size_t idx = leaf->findKey(k);
+        int inserted = 1;
+        if (idx < leaf->keys.size() && leaf->keys[idx] == k) {
+            leaf->values[idx] = val;
+            inserted = 0;
+        }
+        else {
+            leaf->keys.insert(leaf->keys.begin() + idx, k);
+            leaf->values.insert(leaf->values.begin() + idx, val);
+        }
+        leaf->writeUnlock();
+        return inserted;
+    }
+
+    // 已锁住的 parent 下，children[idx] 不足 t 个 key：向兄弟借一个或与兄弟合并
+    void fill(Internal* parent, size_t idx, Node* child, Node* sibling, size_t sibIdx) {
+        size_t sepIdx = std::min(idx, sibIdx);
+        if (sibling->keys.size() > t) {
+            if (sibIdx > idx) borrowFromNext(parent, sepIdx, child, sibling);
+            else borrowFromPrev(parent, sepIdx, child, sibling);
+            sibling->writeUnlock();
+            child->writeUnlock();
+            return;
+        }
+        Node* left = sibIdx < idx ? sibling : child;
+        Node* right = sibIdx < idx ? child : sibling;
+        if (left->isLeaf) {
+            auto l = static_cast<Leaf*>(left);
+            auto r = static_cast<Leaf*>(right);
+            l->keys.insert(l->keys.end(), r->keys.begin(), r->keys.end());
+            l->values.insert(l->values.end(), r->values.begin(), r->values.end());
+        }
+        else {
+            auto l = static_cast<Internal*>(left);
+            auto r = static_cast<Internal*>(right);
+            l->keys.push_back(parent->keys[sepIdx]);
+            l->keys.insert(l->keys.end(), r->keys.begin(), r->keys.end());
+            l->children.insert(l->children.end(), r->children.begin(), r->children.end());
+        }
+        // 右节点被摘下，左节点接管两者的范围
+        parent->keys.erase(parent->keys.begin() + sepIdx);
+        parent->children.erase(parent->children.begin() + sepIdx + 1);
+        right->writeUnlockObsolete();
+        epoch.retire(right, &ConcurrentBPlusTree::deleteNode);
+        left->writeUnlock();
+    }
+
+    void borrowFromNext(Internal* parent, size_t sepIdx, Node* child, Node* sibling) {
+        if (child->isLeaf) {
+            auto c = static_cast<Leaf*>(child);
+            auto s = static_cast<Leaf*>(sibling);
+            c->keys.push_back(s->keys.front());
+            c->values.push_back(s->values.front());
+            s->keys.pop_front();
+            s->values.pop_front();
+            parent->keys[sepIdx] = c->keys.back();
+        }
+        else {
+            auto c = static_cast<Internal*>(child);
+            auto s = static_cast<Internal*>(sibling);
+            c->keys.push_back(parent->keys[sepIdx]);
+            c->children.push_back(s->children.front());
+            parent->keys[sepIdx] = s->keys.front();
+            s->keys.pop_front();
+            s->children.pop_front();
+        }
+    }
+
+    void borrowFromPrev(Internal* parent, size_t sepIdx, Node* child, Node* sibling) {
+        if (child->isLeaf) {
+            auto c = static_cast<Leaf*>(child);
+            auto s = static_cast<Leaf*>(sibling);
+            c->keys.insert(c->keys.begin(), s->keys.back());
+            c->values.insert(c->values.begin(), s->values.back());
+            s->keys.pop_back();
+            s->values.pop_back();
+            parent->keys[sepIdx] = s->keys.back();
+        }
+        else {
+            auto c = static_cast<Internal*>(child);
+            auto s = static_cast<Internal*>(sibling);
+            c->keys.insert(c->keys.begin(), parent->keys[sepIdx]);
+            c->children.insert(c->children.begin(), s->children.back());
+            parent->keys[sepIdx] = s->keys.back();
+            s->keys.pop_back();
+            s->children.pop_back();
+        }
+    }
+
+    // 返回 1 删除成功，0 不存在，-1 需要重来
+    int tryErase(const KeyType& k) {
+        bool needRestart = false;
+        Node* node = root.load();
+        uint64_t v = node->readLockOrRestart(needRestart);
+        if (needRestart || node != root.load()) return -1;
+        Internal* parent = nullptr;
+        uint64_t vParent = 0;
+
+        while (!node->isLeaf) {
+            auto inner = static_cast<Internal*>(node);
+            if (parent) {
+                parent->readUnlockOrRestart(vParent, needRestart);
+                if (needRestart) return -1;
+            }
+            size_t idx = inner->findKey(k);
+            Node* child = inner->children[idx];
+            inner->readUnlockOrRestart(v, needRestart);
+            if (needRestart) return -1;
+            uint64_t vChild = child->readLockOrRestart(needRestart);
+            if (needRestart) return -1;
+
+            // 孩子不足 t 个 key 时先补足再下降，只锁 inner、孩子和一个兄弟
+            if (child->keys.size() < t && inner->children.size() > 1) {
+                inner->upgradeToWriteLockOrRestart(v, needRestart);
+                if (needRestart) return -1;
+                child->upgradeToWriteLockOrRestart(vChild, needRestart);
+                if (needRestart) {
+                    inner->writeUnlock();
+                    return -1;
+                }
+                size_t sibIdx = idx > 0 ? idx - 1 : idx + 1;
+                Node* sibling = inner->children[sibIdx];
+                sibling->tryWriteLockOrRestart(needRestart);
+                if (needRestart) {
+                    child->writeUnlock();
+                    inner->writeUnlock();
+                    return -1;
+                }
+                fill(inner, idx, child, sibling, sibIdx);
+                // 根只剩一个孩子时降低树高
+                if (inner->keys.empty() && inner == root.load()) {
+                    root.store(inner->children[0]);
+                    inner->writeUnlockObsolete();
+                    epoch.retire(inner, &ConcurrentBPlusTree::deleteNode);
+                }
+                else {
+                    inner->writeUnlock();
+                }
+                return -1;
+            }
+            parent = inner;
+            vParent = v;
+            node = child;
+            v = vChild;
+        }
+
+        auto leaf = static_cast<Leaf*>(node);
+        leaf->upgradeToWriteLockOrRestart(v, needRestart);
+        if (needRestart) return -1;
+        if (parent) {
+            parent->readUnlockOrRestart(vParent, needRestart);
+            if (needRestart) {
+                leaf->writeUnlock();
+                return -1;
+            }
+        }
+        size_t idx = leaf->findKey(k);
+        int erased = 0;
+        if (idx < leaf->keys.size() && leaf->keys[idx] == k) {
+            leaf->keys.erase(leaf->keys.begin() + idx);
+            leaf->values.erase(leaf->values.begin() + idx);
+            erased = 1;
+        }
+        leaf->writeUnlock();
+        return erased;
+    }
+};
+
+// 写时复制（copy-on-write）B+ 树的节点，发布后不再修改。
+// txn 为创建它的写事务编号，同一事务内新建的节点尚未发布，可以原地修改
+template<typename KeyType, typename ValueType>
+class CowNode {
+public:
+    bool isLeaf;
+    uint64_t txn;
+    NodeArray<KeyType> keys;
+    // 写入后、分裂前最多暂时有 cap+1 个 key
+    CowNode(size_t cap, bool leaf, uint64_t _txn) : isLeaf(leaf), txn(_txn), keys(cap + 1) {}
+    virtual ~CowNode() = default;
+
+    size_t findKey(const KeyType& k) const {
+        return nodeLowerBound(keys.data(), keys.size(), k);
+    }
+};
+
+template<typename KeyType, typename ValueType>
+class CowLeafNode : public CowNode<KeyType, ValueType> {
+public:
+    NodeArray<ValueType> values;
+    CowLeafNode(size_t cap, uint64_t txn) : CowNode<KeyType, ValueType>(cap, true, txn), values(cap + 1) {}
+};
+
+// 与 OLCInternalNode 相同：children[i] 中的 key 都 <= keys[i] < children[i+1] 中的 key
+template<typename KeyType, typename ValueType>
+class CowInternalNode : public CowNode<KeyType, ValueType> {
+public:
+    NodeArray<CowNode<KeyType, ValueType>*> children;
+    CowInternalNode(size_t cap, uint64_t txn) : CowNode<KeyType, ValueType>(cap, false, txn), children(cap + 2) {}
+};
+
+// 多版本 B+ 树：写者串行，把要改的节点连同到根的路径复制一份，改完后原子地发布新版本；
+// 读者用 snapshot() 拿到某个版本的只读视图，不加锁、不重试，也不受之后写入的影响。
+// 被新版本替换下来的节点交给 EpochManager，持有旧版本的 Snapshot 都释放后才回收。
+// 叶子之间没有链表指针（路径复制无法维护），范围扫描从根下降
+template<typename KeyType, typename ValueType>
+class CowBPlusTree {
+public:
+    using Node = CowNode<KeyType, ValueType>;
+    using Leaf = CowLeafNode<KeyType, ValueType>;
+    using Internal = CowInternalNode<KeyType, ValueType>;
+
+private:
+    // 一个已发布的版本，发布后不再修改
+    struct Version {
+        Node* root;
+        size_t count;
+        uint64_t seq;
+    };
+
+public:
+    // 某个版本的只读视图：持有期间该版本的节点不会被回收。
+    // 可以跨线程移动，但不能比树活得久；同时持有的快照不超过 EpochManager::kMaxHandles 个
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&&) = default;
+        Snapshot& operator=(Snapshot&&) = default;
+
+        size_t size() const { return v->count; }
+        bool empty() const { return v->count == 0; }
+        // 版本号，每次写事务提交加一
+        uint64_t version() const { return v->seq; }
+
+        // 返回的指针在 Snapshot 释放前有效
+        const ValueType* find(const KeyType& k) const {
+            const Leaf* leaf = CowBPlusTree::leafFor(v->root, k);
+            size_t idx = leaf->findKey(k);
+            return idx < leaf->keys.size() && leaf->keys[idx] == k ? &leaf->values[idx] : nullptr;
+        }
+        bool contains(const KeyType& k) const { return find(k) != nullptr; }
+
+        // 按序对 [lo, hi) 中的每一对调用 f(key, value)
+        template<typename F>
+        void scan(const KeyType& lo, const KeyType& hi, F f) const {
+            CowBPlusTree::scanFrom(v->root, lo, &hi, f);
+        }
+        template<typename F>
+        void forEach(F f) const {
+            CowBPlusTree::scanFrom(v->root, std::nullopt, nullptr, f);
+        }
+
+    private:
+        friend class CowBPlusTree;
+        Snapshot(EpochManager::Guard&& g, const Version* _v) : guard(std::move(g)), v(_v) {}
+        EpochManager::Guard guard;
+        const Version* v;
+    };
+
+    // 写事务内的操作，只在 update 的回调里使用；读到的是本事务已写入的状态
+    class Writer {
+    public:
+        // k 不存在则插入，存在则覆盖；返回是否新插入
+        bool insert_or_assign(const KeyType& k, const ValueType& val) { return tree.insertKey(k, val); }
+        // 返回 k 是否存在
+        bool erase(const KeyType& k) { return tree.eraseKey(k); }
+        const ValueType* find(const KeyType& k) const {
+            const Leaf* leaf = CowBPlusTree::leafFor(tree.root, k);
+            size_t idx = leaf->findKey(k);
+            return idx < leaf->keys.size() && leaf->keys[idx] == k ? &leaf->values[idx] : nullptr;
+        }
+        size_t size() const { return tree.count; }
+
+    private:
+        friend class CowBPlusTree;
+        explicit Writer(CowBPlusTree& _tree) : tree(_tree) {}
+        CowBPlusTree& tree;
+    };
+
+    CowBPlusTree(int _t) : t(_t), cap(2 * _t) {
+        if (_t < 2) throw std::invalid_argument("CowBPlusTree: minimum degree must be at least 2");
+        current.store(new Version{ new Leaf(cap, 0), 0, 0 });
+    }
+    ~CowBPlusTree() {
+        Version* v = current.load();
+        destroy(v->root);
+        delete v;
+    }
+    CowBPlusTree(const CowBPlusTree&) = delete;
+    CowBPlusTree& operator=(const CowBPlusTree&) = delete;
+
+    // 当前最新版本的只读视图
+    Snapshot snapshot() const {
+        auto guard = epoch.hold();
+        return Snapshot(std::move(guard), current.load());
+    }
+
+    // 在一个写事务里执行 f(Writer&)，结束后一次性发布；同一事务内同一节点只复制一次
+    template<typename F>
+    void update(F f) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        Version* old = current.load();
+        root = old->root;
+        count = old->count;
+        ++txn;
+        Writer w(*this);
+        try {
+            f(w);
+        }
+        catch (...) {
+            // 放弃本事务：新建的节点都未发布，直接释放；被替换的节点仍属于当前版本
+            discard(root);
+            garbage.clear();
+            throw;
+        }
+        if (root == old->root) return;
+        current.store(new Version{ root, count, old->seq + 1 });
+        epoch.retire(old, &CowBPlusTree::deleteVersion);
+        for (Node* n : garbage) epoch.retire(n, &CowBPlusTree::deleteNode);
+        garbage.clear();
+    }
+
+    bool insert_or_assign(const KeyType& k, const ValueType& val) {
+        bool inserted = false;
+        update([&](Writer& w) { inserted = w.insert_or_assign(k, val); });
+        return inserted;
+    }
+    bool erase(const KeyType& k) {
+        bool erased = false;
+        update([&](Writer& w) { erased = w.erase(k); });
+        return erased;
+    }
+    // 找到 k 时把 value 拷到 out
+    bool find(const KeyType& k, ValueType& out) const {
+        auto guard = epoch.pin();
+        const Leaf* leaf = leafFor(current.load()->root, k);
+        size_t idx = leaf->findKey(k);
+        if (idx == leaf->keys.size() || !(leaf->keys[idx] == k)) return false;
+        out = leaf->values[idx];
+        return true;
+    }
+    // 旧版本由 update() 退休后随时可能被回收，读 count 前同样要 pin
+    size_t size() const {
+        auto guard = epoch.pin();
+        return current.load()->count;
+    }
+
+private:
+    size_t t;
+    size_t cap;  // 每个节点最多 2t 个 key
+    std::atomic<Version*> current;
+    mutable EpochManager epoch;
+
+    // 以下只由持有 writeMutex 的写者访问
+    std::mutex writeMutex;
+    uint64_t txn = 0;
+    Node* root = nullptr;       // 本事务正在构建的根
+    size_t count = 0;
+    std::vector<Node*> garbage; // 本事务替换下来的已发布节点，提交后交给 epoch 回收
+
+    static void deleteNode(void* p) { delete static_cast<Node*>(p); }
+    static void deleteVersion(void* p) { delete static_cast<Version*>(p); }
+
+    static void destroy(Node* node) {
+        if (!node->isLeaf) {
+            for (auto child : static_cast<Internal*>(node)->children)
+                destroy(child);
+        }
+        delete node;
+    }
+
+    // 释放本事务新建、尚未发布的节点；已发布的节点不可能指向新节点，遇到即停
+    void discard(Node* node) {
+        if (node->txn != txn) return;
+        if (!node->isLeaf) {
+            for (auto child : static_cast<Internal*>(node)->children)
+                discard(child);
+        }
+        delete node;
+    }
+
+    static const Leaf* leafFor(const Node* node, const KeyType& k) {
+        while (!node->isLeaf) {
+            auto inner = static_cast<const Internal*>(node);
+            node = inner->children[inner->findKey(k)];
+        }
+        return static_cast<const Leaf*>(node);
+    }
+
+    // 从 >= lo 的第一个 key 起按序访问，遇到 >= *hi 的 key 时返回 false；lo 为空时从头开始，hi 为空时到末尾
+    template<typename F>
+    static bool scanFrom(const Node* node, const std::optional<KeyType>& lo, const KeyType* hi, F& f) {
+        size_t i = lo ? node->findKey(*lo) : 0;
+        if (node->isLeaf) {
+            auto leaf = static_cast<const Leaf*>(node);
+            for (; i < leaf->keys.size(); ++i) {
+                if (hi && !(leaf->keys[i] < *hi)) return false;
+                f(leaf->keys[i], leaf->values[i]);
+            }
+            return true;
+        }
+        auto inner = static_cast<const Internal*>(node);
+        for (; i < inner->children.size(); ++i)
+            if (!scanFrom(inner->children[i], lo, hi, f)) return false;
+        return true;
+    }
+
+    // 本事务可修改的 node：已发布的节点先复制一份，原节点在提交后回收
+    Node* writable(Node* node) {
+        if (node->txn == txn) return node;
+        Node* copy;
+        if (node->isLeaf) {
+            auto src = static_cast<Leaf*>(node);
+            auto dst = new Leaf(cap, txn);
+            dst->keys.assign(src->keys.begin(), src->keys.end());
+            dst->values.assign(src->values.begin(), src->values.end());
+            copy = dst;
+        }
+        else {
+            auto src = static_cast<Internal*>(node);
+            auto dst = new Internal(cap, txn);
+            dst->keys.assign(src->keys.begin(), src->keys.end());
+            dst->children.assign(src->children.begin(), src->children.end());
+            copy = dst;
+        }
+        garbage.push_back(node);
+        return copy;
+    }
+
+    // node 从树上摘下：本事务新建的直接释放，已发布的提交后回收
+    void drop(Node* node) {
+        if (node->txn == txn) delete node;
+        else garbage.push_back(node);
+    }
+
+    // 把超过 cap 个 key 的可写节点分成两半，返回右半和分隔 key（左半的最大 key）
+    Node* split(Node* node, KeyType& sep) {
+        size_t n = node->keys.size(), mid = n / 2;
+        if (node->isLeaf) {
+            auto left = static_cast<Leaf*>(node);
+            auto right = new Leaf(cap, txn);
+            right->keys.assign(left->keys.begin() + mid, left->keys.end());
+            right->values.assign(left->values.begin() + mid, left->values.end());
+            left->keys.resize(mid);
+            left->values.resize(mid);
+            sep = left->keys.back();
+            return right;
+        }
+        auto left = static_cast<Internal*>(node);
+        auto right = new Internal(cap, txn);
+        sep = left->keys[mid];
+        right->keys.assign(left->keys.begin() + mid + 1, left->keys.end());
+        right->children.assign(left->children.begin() + mid + 1, left->children.end());
+        left->keys.resize(mid);
+        left->children.resize(mid + 1);
+        return right;
+    }
+
+    bool insertKey(const KeyType& k, const ValueType& val) {
+        bool inserted = false;
+        Node* right = nullptr;
+        KeyType sep;
+        root = insertInto(root, k, val, inserted, right, sep);
+        if (right) {
+            auto newRoot = new Internal(cap, txn);
+            newRoot->keys.push_back(sep);
+            newRoot->children.push_back(root);
+            newRoot->children.push_back(right);
+            root = newRoot;
+        }
+        if (inserted) ++count;
+        return inserted;
+    }
+
+    // 返回替换 node 的可写节点；node 分裂时 right 为右半、sep 为分隔 key
+    Node* insertInto(Node* node, const KeyType& k, const ValueType& val, bool& inserted, Node*& right, KeyType& sep) {
+        Node* w = writable(node);
+        size_t idx = w->findKey(k);
+        if (w->isLeaf) {
+            auto leaf = static_cast<Leaf*>(w);
+            if (idx < leaf->keys.size() && leaf->keys[idx] == k) {
+                leaf->values[idx] = val;
+                return w;
+            }
+            leaf->keys.insert(leaf->keys.begin() + idx, k);
+            leaf->values.insert(leaf->values.begin() + idx, val);
+            inserted = true;
+        }
+        else {
+            auto inner = static_cast<Internal*>(w);
+            // 比所有分隔 key 都大时进入最右的孩子
+            Node* childRight = nullptr;
+            KeyType childSep;
+            inner->children[idx] = insertInto(inner->children[idx], k, val, inserted, childRight, childSep);
+            if (childRight) {
+                inner->keys.insert(inner->keys.begin() + idx, childSep);
+                inner->children.insert(inner->children.begin() + idx + 1, childRight);
+            }
+        }
+        if (w->keys.size() > cap) right = split(w, sep);
+        return w;
+    }
+
+    bool eraseKey(const KeyType& k) {
+        // 不存在时不复制路径
+        const Leaf* leaf = leafFor(root, k);
+        size_t idx = leaf->findKey(k);
+        if (idx == leaf->keys.size() || !(leaf->keys[idx] == k)) return false;
+        root = eraseFrom(root, k);
+        // 根只剩一个孩子时降低树高
+        if (!root->isLeaf && root->keys.empty()) {
+            Node* old = root;
+            root = static_cast<Internal*>(old)->children[0];
+            drop(old);
+        }
+        --count;
+        return true;
+    }
+
+    // k 一定存在；返回替换 node 的可写节点，它可能不足 t 个 key，由父节点补足
+    Node* eraseFrom(Node* node, const KeyType& k) {
+        Node* w = writable(node);
+        size_t idx = w->findKey(k);
+        if (w->isLeaf) {
+            auto leaf = static_cast<Leaf*>(w);
+            leaf->keys.erase(leaf->keys.begin() + idx);
+            leaf->values.erase(leaf->values.begin() + idx);
+            return w;
+        }
+        auto inner = static_cast<Internal*>(w);
+        Node* child = eraseFrom(inner->children[idx], k);
+        inner->children[idx] = child;
+        if (child->keys.size() < t) fill(inner, idx);
+        return w;
+    }
+
+    // 可写的 parent 下，children[idx] 不足 t 个 key：向兄弟借一个或与兄弟合并
+    void fill(Internal* parent, size_t idx) {
+        size_t sibIdx = idx > 0 ? idx - 1 : idx + 1;
+        Node* child = parent->children[idx];
+        Node* sibling = parent->children[sibIdx];
+        size_t sepIdx = std::min(idx, sibIdx);
+        if (sibling->keys.size() > t) {
+            sibling = parent->children[sibIdx] = writable(sibling);
+            if (sibIdx > idx) borrowFromNext(parent, sepIdx, child, sibling);
+            else borrowFromPrev(parent, sepIdx, child, sibling);
+            return;
+        }
+        // 合并进左边的节点，右节点从树上摘下
+        Node* left = sibIdx < idx ? parent->children[sibIdx] = writable(sibling) : child;
+        Node* right = sibIdx < idx ? child : sibling;
+        if (left->isLeaf) {
+            auto l = static_cast<Leaf*>(left);
+            auto r = static_cast<Leaf*>(right);
+            l->keys.insert(l->keys.end(), r->keys.begin(), r->keys.end());
+            l->values.insert(l->values.end(), r->values.begin(), r->values.end());
+        }
+        else {
+            auto l = static_cast<Internal*>(left);
+            auto r = static_cast<Internal*>(right);
+            l->keys.push_back(parent->keys[sepIdx]);
+            l->keys.insert(l->keys.end(), r->keys.begin(), r->keys.end());
+            l->children.insert(l->children.end(), r->children.begin(), r->children.end());
+        }
+        parent->keys.erase(parent->keys.begin() + sepIdx);
+        parent->children.erase(parent->children.begin() + sepIdx + 1);
+        drop(right);
+    }
+
+    void borrowFromNext(Internal* parent, size_t sepIdx, Node* child, Node* sibling) {
+        if (child->isLeaf) {
+            auto c = static_cast<Leaf*>(child);
+            auto s = static_cast<Leaf*>(sibling);
+            c->keys.push_back(s->keys.front());
+            c->values.push_back(s->values.front());
+            s->keys.pop_front();
+            s->values.pop_front();
+            parent->keys[sepIdx] = c->keys.back();
+        }
+        else {
+            auto c = static_cast<Internal*>(child);
+            auto s = static_cast<Internal*>(sibling);
+            c->keys.push_back(parent->keys[sepIdx]);
+            c->children.push_back(s->children.front());
+            parent->keys[sepIdx] = s->keys.front();
+            s->keys.pop_front();
+            s->children.pop_front();
+        }
+    }
+
+    void borrowFromPrev(Internal* parent, size_t sepIdx, Node* child, Node* sibling) {
+        if (child->isLeaf) {
+            auto c = static_cast<Leaf*>(child);
+            auto s = static_cast<Leaf*>(sibling);
+            c->keys.insert(c->keys.begin(), s->keys.back());
+            c->values.insert(c->values.begin(), s->values.back());
+            s->keys.pop_back();
+            s->values.pop_back();
+            parent->keys[sepIdx] = s->keys.back();
+        }
+        else {
+            auto c = static_cast<Internal*>(child);
+            auto s = static_cast<Internal*>(sibling);
+            c->keys.insert(c->keys.begin(), parent->keys[sepIdx]);
+            c->children.insert(c->children.begin(), s->children.back());
+            parent->keys[sepIdx] = s->keys.back();
+            s->keys.pop_back();
+            s->children.pop_back();
+        }
+    }
+};
+
+// 多生产者、单消费者的无锁队列（Vyukov）：生产者对 head 做一次 exchange 再接上 next，
+// 消费者独占 tail，tail 始终指向一个值已取走的哑节点
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(new Node()), tail(head.load()) {}
+    ~MpscQueue() {
+        T tmp;
+        while (pop(tmp)) {}
+        delete tail;
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T v) {
+        Node* n = new Node();
+        n->value = std::move(v);
+        Node* prev = head.exchange(n);
+        // 接上之前消费者看不到 n，只会认为队列暂时为空
+        prev->next.store(n);
+    }
+
+    // 只能由消费者线程调用
+    bool pop(T& out) {
+        Node* next = tail->next.load();
+        if (!next) return false;
+        out = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+    bool empty() const { return tail->next.load() == nullptr; }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        T value{};
+    };
+    // 生产者和消费者各写各的缓存行
+    alignas(64) std::atomic<Node*> head;
+    alignas(64) Node* tail;
+};
+
+// 按 key 区间分片的 B+ 树前端：bounds 把 key 空间切成若干段，每段是一棵独立的 BPlusTree，
+// 只由自己的工作线程访问，树本身不加锁，分片之间不共享节点和分配器。
+// 操作按区间路由到分片的 MpscQueue；批量操作拆给各分片并行执行，全部完成后经 future 返回。
+// 边界放在不可变的路由表里，经原子指针发布：生产者只 pin 本线程的 epoch slot 再读表，
+// 不写共享状态；rebalance 换一张新表，等宽限期过后释放旧表
+template<typename KeyType, typename ValueType, typename Alloc = SlabArena>
+class ShardedBPlusTree {
+public:
+    using Tree = BPlusTree<KeyType, ValueType, Alloc>;
+
+    // 分片 i 负责 [bounds[i-1], bounds[i])，共 bounds.size() + 1 个分片。
+    // 最大分片超过平均大小的 skew 倍时批量写入后通知协调线程 rebalance，skew 为 0 时不自动做
+    ShardedBPlusTree(int _t, std::vector<KeyType> _bounds, double _skew = 2.0)
+        : t(_t), skew(_skew) {
+        for (size_t i = 1; i < _bounds.size(); ++i)
+            if (!(_bounds[i - 1] < _bounds[i])) throw std::invalid_argument("ShardedBPlusTree: bounds must be strictly increasing");
+        for (size_t i = 0; i <= _bounds.size(); ++i) shards.push_back(std::make_unique<Shard>(t));
+        routing.store(new Routing{ std::move(_bounds) });
+        for (auto& s : shards) s->worker = std::thread([sp = s.get()] { run(*sp); });
+        if (skew > 0) coordinator = std::thread([this] { coordinate(); });
+    }
+    // 先停协调线程（做到一半的 rebalance 会做完），已提交的操作执行完后分片才退出
+    ~ShardedBPlusTree() {
+        if (coordinator.joinable()) {
+            {
+                std::lock_guard<std::mutex> lk(coordMutex);
+                coordStop = true;
+            }
+            coordCv.notify_one();
+            coordinator.join();
+        }
+        for (auto& s : shards) {
+            s->stop = true;
+            wake(*s);
+        }
+        for (auto& s : shards) s->worker.join();
+        delete routing.load();
+    }
+    ShardedBPlusTree(const ShardedBPlusTree&) = delete;
+    ShardedBPlusTree& operator=(const ShardedBPlusTree&) = delete;
+
+    size_t shardCount() const { return shards.size(); }
+
+    // 元素个数，由各分片执行完每个操作后更新，执行中的操作未计入
+    size_t size() const {
+        size_t n = 0;
+        for (auto& s : shards) n += s->count.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // 各分片当前负责的区间边界
+    std::vector<KeyType> boundaries() const {
+        auto guard = epoch.pin();
+        return routing.load()->bounds;
+    }
+
+    std::future<bool> insert_or_assign(const KeyType& k, const ValueType& v) {
+        auto done = std::make_shared<std::promise<bool>>();
+        auto result = done->get_future();
+        auto guard = epoch.pin();
+        post(routing.load()->shardOf(k), [done, k, v](Tree& tree) { done->set_value(tree.insert_or_assign(k, v)); });
+        return result;
+    }
+
+    std::future<std::optional<ValueType>> find(const KeyType& k) {
+        auto done = std::make_shared<std::promise<std::optional<ValueType>>>();
+        auto result = done->get_future();
+        auto guard = epoch.pin();
+        post(routing.load()->shardOf(k), [done, k](Tree& tree) {
+            ValueType* v = tree.find(k);
+            done->set_value(v ? std::optional<ValueType>(*v) : std::nullopt);
+        });
+        return result;
+    }
+
+    std::future<bool> erase(const KeyType& k) {
+        auto done = std::make_shared<std::promise<bool>>();
+        auto result = done->get_future();
+        auto guard = epoch.pin();
+        post(routing.load()->shardOf(k), [done, k](Tree& tree) { done->set_value(tree.erase(k)); });
+        return result;
+    }
+
+    // 按 BPlusTree::insertBatch 的覆盖语义批量写入，结果为新插入的个数
+    std::future<size_t> insertBatch(std::vector<std::pair<KeyType, ValueType>> items) {
+        std::future<size_t> result;
+        {
+            auto guard = epoch.pin();
+            const Routing* r = routing.load();
+            std::vector<std::vector<std::pair<KeyType, ValueType>>> parts(shards.size());
+            for (auto& item : items) parts[r->shardOf(item.first)].push_back(std::move(item));
+            auto batch = makeBatch<size_t>(nonEmpty(parts), result);
+            for (size_t i = 0; i < parts.size(); ++i) {
+                if (parts[i].empty()) continue;
+                post(i, [batch, part = std::move(parts[i])](Tree& tree) mutable {
+                    batch->total += tree.insertBatch(part.begin(), part.end());
+                    batch->finishOne();
+                });
+            }
+        }
+        if (skew > 0) maybeRebalance();
+        return result;
+    }
+
+    // 批量查找，结果的第 i 项对应 keys[i]，不存在为 nullopt
+    std::future<std::vector<std::optional<ValueType>>> findBatch(const std::vector<KeyType>& keys) {
+        std::future<std::vector<std::optional<ValueType>>> result;
+        auto guard = epoch.pin();
+        const Routing* r = routing.load();
+        // 每个分片拿到自己那部分 key 及其在 keys 中的下标，结果写回各自的下标，互不重叠
+        std::vector<std::vector<size_t>> parts(shards.size());
+        for (size_t i = 0; i < keys.size(); ++i) parts[r->shardOf(keys[i])].push_back(i);
+        auto batch = makeBatch<std::vector<std::optional<ValueType>>>(nonEmpty(parts), result);
+        batch->out.resize(keys.size());
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (parts[i].empty()) continue;
+            std::vector<KeyType> sub;
+            sub.reserve(parts[i].size());
+            for (size_t idx : parts[i]) sub.push_back(keys[idx]);
+            post(i, [batch, sub = std::move(sub), idx = std::move(parts[i])](Tree& tree) {
+                std::vector<ValueType*> found(sub.size());
+                tree.findBatch(sub.data(), sub.size(), found.data());
+                for (size_t j = 0; j < sub.size(); ++j)
+                    if (found[j]) batch->out[idx[j]] = *found[j];
+                batch->finishOne();
+            });
         }
-        sibling->parent = child->parent;
-        // 把 sibling 最后一个 key 上移到父节点
-        keys[idx - 1] = sibling->keys.back();
+        return result;
     }
 
-    void borrowFromNext(size_t idx) {
-        BPlusNode<KeyType>* child = children[idx];
-        BPlusNode<KeyType>* sibling = children[idx + 1];
-        // child 的 keys 后移，腾出位置
-        child->keys.insert(child->keys.end(), sibling->keys.front());
-        sibling->keys.pop_front();
-        if (!child->isLeaf) {
-            BPlusInternalNode<KeyType>* childNode = static_cast<BPlusInternalNode<KeyType>*>(child);
-            BPlusInternalNode<KeyType>* siblingNode = static_cast<BPlusInternalNode<KeyType>*>(sibling);
-            childNode->children.insert(childNode->children.end(), siblingNode->children.front());
-            siblingNode->children.pop_front();
+    // 批量删除，结果为实际删除的个数
+    std::future<size_t> eraseBatch(const std::vector<KeyType>& keys) {
+        std::future<size_t> result;
+        {
+            auto guard = epoch.pin();
+            const Routing* r = routing.load();
+            std::vector<std::vector<KeyType>> parts(shards.size());
+            for (auto& k : keys) parts[r->shardOf(k)].push_back(k);
+            auto batch = makeBatch<size_t>(nonEmpty(parts), result);
+            for (size_t i = 0; i < parts.size(); ++i) {
+                if (parts[i].empty()) continue;
+                post(i, [batch, part = std::move(parts[i])](Tree& tree) {
+                    size_t n = 0;
+                    for (auto& k : part) n += tree.erase(k);
+                    batch->total += n;
+                    batch->finishOne();
+                });
+            }
         }
-        sibling->parent = child->parent;
-        // 把 sibling 最后一个 key 上移到父节点
-        keys[idx + 1] = sibling->keys.front();
+        if (skew > 0) maybeRebalance();
+        return result;
     }
 
-    // 合并 children[idx] 和 children[idx-1]
-    void mergePrev(size_t idx) {
-        BPlusNode<KeyType>* child = children[idx];
-        BPlusNode<KeyType>* sibling = children[idx - 1];
-        // child 的 keys 后移，腾出位置
-        child->keys.insert(child->keys.begin(), sibling->keys.begin(), sibling->keys.end());
-        sibling->keys.clear();
-        if (!child->isLeaf) {
-            BPlusInternalNode<KeyType>* childNode = static_cast<BPlusInternalNode<KeyType>*>(child);
-            BPlusInternalNode<KeyType>* siblingNode = static_cast<BPlusInternalNode<KeyType>*>(sibling);
-            childNode->children.insert(childNode->children.begin(), siblingNode->children.begin(), siblingNode->children.end());
-            siblingNode->children.clear();
+    // 等待此前提交的操作全部执行完；分片个数固定，不需要读路由表
+    void sync() {
+        std::future<size_t> result;
+        auto batch = makeBatch<size_t>(shards.size(), result);
+        for (size_t i = 0; i < shards.size(); ++i) post(i, [batch](Tree&) { batch->finishOne(); });
+        result.wait();
+    }
+
+    // 最大的分片超过平均大小的 factor 倍时，把它的一部分移给较小的相邻分片，使两者大小持平，
+    // 返回是否移动了边界。只阻塞调用线程和这两个分片，其余分片和生产者照常运行：
+    //   1. 大分片在自己的线程上定切分点；
+    //   2. 邻居停在交接点上，此后路由给它的操作都排在交接之后；
+    //   3. 发布新路由表，宽限期过后不再有生产者按旧表投递，旧表直接释放；
+    //   4. 大分片执行完按旧表排到它队列里的操作，把切下的一段 bulkLoad 成新树交出去，
+    //      邻居在自己的线程上 join。
+    // 同一个 key 的操作要么都在交接前由大分片执行，要么都在交接后由邻居执行，先后次序不变。
+    // 新树用自己的分配器，移动后分片之间仍不共用分配器
+    bool rebalance(double factor = 2.0) {
+        std::lock_guard<std::mutex> lk(rebalanceMutex);
+        size_t big = 0;
+        if (!skewed(factor, big)) return false;
+        size_t nb = big + 1 == shards.size() || (big > 0 && shards[big - 1]->count < shards[big + 1]->count)
+            ? big - 1 : big + 1;
+        bool right = nb > big;
+
+        std::promise<std::optional<KeyType>> cutDone;
+        auto cutResult = cutDone.get_future();
+        post(big, [&cutDone, right, b = shards[nb]->count.load()](Tree& tree) {
+            size_t a = tree.size();
+            size_t move = a > b ? (a - b) / 2 : 0;
+            if (move == 0) cutDone.set_value(std::nullopt);
+            else cutDone.set_value(tree.select(right ? a - move : move).key());
+        });
+        std::optional<KeyType> cut = cutResult.get();
+        if (!cut) return false;
+
+        auto handoff = std::make_shared<Handoff>();
+        post(nb, [handoff](Tree& tree) {
+            std::unique_lock<std::mutex> hlk(handoff->m);
+            handoff->cv.wait(hlk, [&] { return handoff->moved != nullptr; });
+            tree.join(*handoff->moved);
+            handoff->joined = true;
+            handoff->cv.notify_all();
+        });
+
+        Routing* old = routing.load();
+        Routing* next = new Routing{ old->bounds };
+        KeyType lo = right ? *cut : old->bounds[nb];
+        KeyType hi = right ? old->bounds[big] : *cut;
+        next->bounds[right ? big : nb] = *cut;
+        routing.store(next);
+        epoch.synchronize();
+        delete old;
+
+        post(big, [handoff, lo, hi, t = t](Tree& tree) {
+            std::vector<std::pair<KeyType, ValueType>> items;
+            for (auto it = tree.lower_bound(lo); it != tree.end() && it.key() < hi; ++it)
+                items.emplace_back(it.key(), it.value());
+            auto moved = std::make_unique<Tree>(t);
+            moved->bulkLoad(items.begin(), items.end());
+            tree.eraseRange(lo, hi);
+            {
+                std::lock_guard<std::mutex> hlk(handoff->m);
+                handoff->moved = std::move(moved);
+            }
+            handoff->cv.notify_all();
+        });
+        std::unique_lock<std::mutex> hlk(handoff->m);
+        handoff->cv.wait(hlk, [&] { return handoff->joined; });
+        return true;
+    }
+
+private:
+    using Task = std::function<void(Tree&)>;
+
+    struct Shard {
+        Tree tree;
+        MpscQueue<Task> queue;
+        std::atomic<size_t> count{ 0 };
+        std::atomic<bool> stop{ false };
+        std::atomic<bool> sleeping{ false };
+        std::mutex m;
+        std::condition_variable cv;
+        std::thread worker;
+        explicit Shard(int t) : tree(t) {}
+    };
+
+    // 发布后不再修改，换边界时整张换新
+    struct Routing {
+        std::vector<KeyType> bounds;
+        size_t shardOf(const KeyType& k) const {
+            return std::upper_bound(bounds.begin(), bounds.end(), k) - bounds.begin();
         }
-        // 把 sibling 最后一个 key 上移到父节点
-        keys.erase(keys.begin() + idx - 1);
-        children.erase(children.begin() + idx - 1);
+    };
 
-        if (child->isLeaf) {
-            BPlusLeafNode<KeyType>* childNode = static_cast<BPlusLeafNode<KeyType>*>(child);
-            BPlusLeafNode<KeyType>* siblingNode = static_cast<BPlusLeafNode<KeyType>*>(sibling);
-            childNode->prev = siblingNode->prev;
-            if (siblingNode->prev) siblingNode->prev->next = childNode;
+    // 批量操作的共享状态：各分片写 out 中互不重叠的部分或把计数加到 total，
+    // 最后一个做完的分片兑现 promise
+    template<typename R>
+    struct Batch {
+        R out{};
+        std::atomic<size_t> total{ 0 };
+        std::atomic<size_t> pending;
+        std::promise<R> done;
+        explicit Batch(size_t n) : pending(n) {}
+        void finishOne() {
+            if (pending.fetch_sub(1) != 1) return;
+            if constexpr (std::is_same<R, size_t>::value) done.set_value(total.load());
+            else done.set_value(std::move(out));
         }
-        
-        // 释放 sibling（可选）
-        delete sibling;
+    };
+
+    // rebalance 的交接点：大分片把切下的一段放进 moved，邻居 join 完置 joined
+    struct Handoff {
+        std::mutex m;
+        std::condition_variable cv;
+        std::unique_ptr<Tree> moved;
+        bool joined = false;
+    };
+
+    int t;
+    double skew;
+    std::atomic<Routing*> routing{ nullptr };
+    mutable EpochManager epoch;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::mutex rebalanceMutex;  // 同一时刻只做一次 rebalance
+
+    // 协调线程：批量写入发现失衡时只置 coordWanted 并唤醒它，搬数据不占生产者的线程
+    std::thread coordinator;
+    std::mutex coordMutex;
+    std::condition_variable coordCv;
+    std::atomic<bool> coordWanted{ false };
+    bool coordStop = false;
+
+    template<typename Parts>
+    static size_t nonEmpty(const Parts& parts) {
+        return std::count_if(parts.begin(), parts.end(), [](const auto& p) { return !p.empty(); });
     }
 
-    // 合并 children[idx] 和 children[idx+1]
-    void mergeNext(size_t idx) {
-        BPlusNode<KeyType>* child = children[idx];
-        BPlusNode<KeyType>* sibling = children[idx + 1];
-        // child 的 keys 后移，腾出位置
-        child->keys.insert(child->keys.end(), sibling->keys.begin(), sibling->keys.end());
-        sibling->keys.clear();
-        if (!child->isLeaf) {
-            BPlusInternalNode<KeyType>* childNode = static_cast<BPlusInternalNode<KeyType>*>(child);
-            BPlusInternalNode<KeyType>* siblingNode = static_cast<BPlusInternalNode<KeyType>*>(sibling);
-            childNode->children.insert(childNode->children.end(), siblingNode->children.begin(), siblingNode->children.end());
-            siblingNode->children.clear();
-        }
+    // 等 n 个分片做完；多算一份再立即减掉，n 为 0 时当场兑现
+    template<typename R>
+    std::shared_ptr<Batch<R>> makeBatch(size_t n, std::future<R>& result) {
+        auto batch = std::make_shared<Batch<R>>(n + 1);
+        result = batch->done.get_future();
+        batch->finishOne();
+        return batch;
+    }
 
-        // 把 sibling 最后一个 key 上移到父节点
-        keys.erase(keys.begin() + idx + 1);
-        children.erase(children.begin() + idx + 1);
-        keys[idx] = child->keys.back();
+    void post(size_t i, Task task) {
+        shards[i]->queue.push(std::move(task));
+        wake(*shards[i]);
+    }
 
-        if (child->isLeaf) {
-            BPlusLeafNode<KeyType>* childNode = static_cast<BPlusLeafNode<KeyType>*>(child);
-            BPlusLeafNode<KeyType>* siblingNode = static_cast<BPlusLeafNode<KeyType>*>(sibling);
-            childNode->next = siblingNode->next;
-            if (siblingNode->next) siblingNode->next->prev = childNode;
+    // 与 run 中先置 sleeping 再检查队列配对：两边至少有一方看到对方的写入
+    static void wake(Shard& s) {
+        if (s.sleeping.load()) {
+            std::lock_guard<std::mutex> lk(s.m);
+            s.cv.notify_one();
         }
+    }
 
-        // 释放 sibling（可选）
-        delete sibling;
+    // 工作线程：取任务执行，队列空时先自旋让出一会儿，再睡到有新任务
+    static void run(Shard& s) {
+        Task task;
+        for (;;) {
+            if (s.queue.pop(task)) {
+                task(s.tree);
+                task = nullptr;
+                s.count.store(s.tree.size(), std::memory_order_relaxed);
+                continue;
+            }
+            if (s.stop.load()) return;
+            bool ready = false;
+            for (int i = 0; i < 64 && !(ready = !s.queue.empty()); ++i) std::this_thread::yield();
+            if (ready) continue;
+            std::unique_lock<std::mutex> lk(s.m);
+            s.sleeping = true;
+            s.cv.wait(lk, [&] { return !s.queue.empty() || s.stop.load(); });
+            s.sleeping = false;
+        }
     }
 
-    // 遍历（调试用）
-    void traverse(int depth = 0) {
-        // 缩进
-        for (int i = 0; i < depth; ++i) std::cout << "  ";
-        std::cout << "[";
-        for (int i = 0; i < keys.size(); ++i) {
-            std::cout << keys[i];
-            if (i + 1 < keys.size()) std::cout << ", ";
+    // 按各分片的近似大小判断是否失衡，big 为最大的分片
+    bool skewed(double factor, size_t& big) const {
+        if (shards.size() < 2) return false;
+        size_t total = 0;
+        for (size_t i = 0; i < shards.size(); ++i) {
+            total += shards[i]->count;
+            if (shards[i]->count > shards[big]->count) big = i;
         }
-        std::cout << "]";
-        std::cout << (isLeaf ? " (leaf)" : "") << "\n";
-        if (!isLeaf) {
-            for (int i = 0; i < children.size(); ++i) {
-                children[i]->traverse(depth + 1);
+        // 数据太少时不值得搬
+        return total >= 1024 * shards.size() && shards[big]->count > factor * total / shards.size();
+    }
+
+    // 只读各分片的计数；已有请求在等协调线程处理时不再加锁通知
+    void maybeRebalance() {
+        size_t big = 0;
+        if (!skewed(skew, big) || coordWanted.load() || coordWanted.exchange(true)) return;
+        {
+            std::lock_guard<std::mutex> lk(coordMutex);
+        }
+        coordCv.notify_one();
+    }
+
+    // 收到请求后一直搬到不再失衡，再清掉请求
+    void coordinate() {
+        std::unique_lock<std::mutex> lk(coordMutex);
+        for (;;) {
+            coordCv.wait(lk, [&] { return coordStop || coordWanted.load(); });
+            if (coordStop) return;
+            lk.unlock();
+            while (rebalance(skew)) {
+                std::lock_guard<std::mutex> slk(coordMutex);
+                if (coordStop) break;
             }
+            coordWanted = false;
+            lk.lock();
         }
     }
 };
 
-template<typename KeyType>
-class BPlusTree {
+#if defined(__unix__) || defined(__APPLE__)
+// 页式 B+ 树的读盘方式：pread 直接读进缓冲帧，或从文件的只读映射里拷贝（缺页由内核完成）
+enum class PagedIoMode { Pread, Mmap };
+
+// 固定页大小的缓冲池：nFrames 个帧，时钟算法淘汰未被 pin 的页，脏页淘汰时写回
+class BufferPool {
 public:
-    size_t t;
-    BPlusNode<KeyType>* root;
-    BPlusTree(int _t) : root(nullptr), t(_t) {}
+    using PageId = uint64_t;
 
-    // 搜索
-    BPlusLeafNode<KeyType>* search(const KeyType& k) {
-        if (!root) return nullptr;
-        BPlusNode<KeyType>* cur = root;
-        // 向下查找到叶子
-        while (!cur->isLeaf) {
-            auto inode = static_cast<BPlusInternalNode<KeyType>*>(cur);
-            int idx = inode->findKey(k);
-            cur = inode->children[idx];
+    BufferPool(int _fd, size_t _pageSize, size_t nFrames, PagedIoMode _mode)
+        : fd(_fd), pageSize(_pageSize), mode(_mode), frames(nFrames), hand(0),
+          mapped(nullptr), mappedSize(0), reads(0), writes(0) {
+        for (auto& f : frames) {
+            f.data = static_cast<char*>(std::aligned_alloc(64, (pageSize + 63) / 64 * 64));
+            if (!f.data) throw std::bad_alloc();
         }
-        auto leaf = static_cast<BPlusLeafNode<KeyType>*>(cur);
-        // 在 leaf->keys 中查找
-        auto it = std::lower_bound(leaf->keys.begin(), leaf->keys.end(), k);
-        if (it != leaf->keys.end() && *it == k)
-            return leaf;
-        return nullptr;
     }
 
-    // 插入
-    void insert(const KeyType& k) {
-        if (!root) {
-            auto leaf = new BPlusLeafNode<KeyType>(t);
-            leaf->keys.push_back(k);
-            root = leaf;
-            return;
+    ~BufferPool() {
+        for (auto& f : frames) std::free(f.data);
+        if (mapped) munmap(mapped, mappedSize);
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // 取页并 pin，调用方用完后必须 unpin
+    char* pin(PageId pid) {
+        auto it = table.find(pid);
+        if (it != table.end()) {
+            Frame& f = frames[it->second];
+            f.pinCount++;
+            f.ref = true;
+            return f.data;
         }
-        root->insert(k);
-        if (root->keys.size() > 2 * t) {
-            auto s = new BPlusInternalNode<KeyType>(t);
-            s->keys.push_back(root->keys.back());
-            s->children.push_back(root);
-            root->parent = s;
-            root = s;
-            s->splitChild(0);
+        size_t idx = victim();
+        Frame& f = frames[idx];
+        readPage(pid, f.data);
+        f.pid = pid;
+        f.pinCount = 1;
+        f.ref = true;
+        f.dirty = false;
+        table[pid] = idx;
+        return f.data;
+    }
+
+    // 新页不读盘，直接清零后 pin，并标记为脏
+    char* pinNew(PageId pid) {
+        size_t idx = victim();
+        Frame& f = frames[idx];
+        std::memset(f.data, 0, pageSize);
+        f.pid = pid;
+        f.pinCount = 1;
+        f.ref = true;
+        f.dirty = true;
+        table[pid] = idx;
+        return f.data;
+    }
+
+    void unpin(PageId pid, bool dirty) {
+        Frame& f = frames[table.at(pid)];
+        f.pinCount--;
+        f.dirty = f.dirty || dirty;
+    }
+
+    void flushAll() {
+        for (auto& f : frames) {
+            if (f.pid != kNoPage && f.dirty) {
+                writePage(f.pid, f.data);
+                f.dirty = false;
+            }
         }
     }
 
-    // 删除
-    void remove(const KeyType& k) {
-        if (!root) {
-            std::cout << "Empty tree\n";
-            return;
+    size_t pageReads() const { return reads; }
+    size_t pageWrites() const { return writes; }
+
+private:
+    static constexpr PageId kNoPage = UINT64_MAX;
+    struct Frame {
+        PageId pid = kNoPage;
+        char* data = nullptr;
+        int pinCount = 0;
+        bool dirty = false;
+        bool ref = false;  // 时钟算法的访问位
+    };
+
+    int fd;
+    size_t pageSize;
+    PagedIoMode mode;
+    std::vector<Frame> frames;
+    std::unordered_map<PageId, size_t> table;  // 页号 -> 帧下标
+    size_t hand;
+    char* mapped;
+    size_t mappedSize;
+    size_t reads, writes;
+
+    // 时钟算法找一个可用帧：跳过被 pin 的帧，访问位为 1 的清零后给第二次机会
+    size_t victim() {
+        for (size_t step = 0; step < 2 * frames.size() + 1; ++step) {
+            size_t idx = hand;
+            hand = (hand + 1) % frames.size();
+            Frame& f = frames[idx];
+            if (f.pid == kNoPage) return idx;
+            if (f.pinCount > 0) continue;
+            if (f.ref) {
+                f.ref = false;
+                continue;
+            }
+            if (f.dirty) writePage(f.pid, f.data);
+            table.erase(f.pid);
+            f.pid = kNoPage;
+            return idx;
         }
+        throw std::runtime_error("BufferPool: all frames are pinned");
+    }
 
-        if (!root->remove(k)) {
-            // 不存在
-            std::cout << "Key " << k << " does not exist in the tree\n";
+    void readPage(PageId pid, char* buf) {
+        ++reads;
+        off_t off = static_cast<off_t>(pid * pageSize);
+        if (mode == PagedIoMode::Mmap) {
+            // 文件变长后重新映射
+            if (off + pageSize > mappedSize) remap();
+            std::memcpy(buf, mapped + off, pageSize);
             return;
         }
-        if (root->isLeaf) {
-            if (root->keys.size() == 0) {
-                delete root;
-                root = nullptr;
-            }
+        if (pread(fd, buf, pageSize, off) != static_cast<ssize_t>(pageSize))
+            throw std::runtime_error("BufferPool: pread failed");
+    }
+
+    void writePage(PageId pid, const char* buf) {
+        ++writes;
+        off_t off = static_cast<off_t>(pid * pageSize);
+        if (pwrite(fd, buf, pageSize, off) != static_cast<ssize_t>(pageSize))
+            throw std::runtime_error("BufferPool: pwrite failed");
+    }
+
+    void remap() {
+        if (mapped) munmap(mapped, mappedSize);
+        mapped = nullptr;
+        struct stat st;
+        if (fstat(fd, &st) != 0) throw std::runtime_error("BufferPool: fstat failed");
+        mappedSize = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) throw std::runtime_error("BufferPool: mmap failed");
+        mapped = static_cast<char*>(p);
+    }
+};
+
+// 存在磁盘文件里的 B+ 树：每个节点是一个定长页，孩子用页号而不是指针。
+// 第 0 页是元数据页。所有页访问都经过缓冲池，任意时刻最多 pin 住 3 页，
+// 因此内存占用由缓冲池大小决定，与数据量无关，一次查找读盘次数不超过树高。
+// 分裂在下降途中提前进行（同 BTreeNode::insertNonFull）；删除只从叶子移除，不做合并。
+// key 和 value 以原始字节写盘，必须可平凡拷贝
+template<typename KeyType, typename ValueType>
+class PagedBPlusTree {
+    static_assert(std::is_trivially_copyable<KeyType>::value, "paged tree stores raw key bytes");
+    static_assert(std::is_trivially_copyable<ValueType>::value, "paged tree stores raw value bytes");
+public:
+    using PageId = BufferPool::PageId;
+
+    // 打开或新建 path；poolPages 为缓冲池帧数
+    PagedBPlusTree(const std::string& path, size_t poolPages,
+                   PagedIoMode mode = PagedIoMode::Pread, size_t _pageSize = 4096)
+        : fd(open(path.c_str(), O_RDWR | O_CREAT, 0644)), pageSize(_pageSize) {
+        if (fd < 0) throw std::runtime_error("PagedBPlusTree: cannot open " + path);
+        leafCap = layout(sizeof(ValueType), alignof(ValueType), 0, valuesOffset);
+        innerCap = layout(sizeof(PageId), alignof(PageId), 1, childrenOffset);
+        if (leafCap < 3 || innerCap < 3) {
+            close(fd);
+            throw std::runtime_error("PagedBPlusTree: page too small for key/value");
+        }
+        pool.reset(new BufferPool(fd, pageSize, std::max<size_t>(poolPages, 4), mode));
+
+        struct stat st;
+        fstat(fd, &st);
+        if (st.st_size == 0) {
+            meta = { kMagic, pageSize, 1, 2 };
+            char* leaf = pool->pinNew(1);
+            header(leaf)->isLeaf = 1;
+            pool->unpin(1, true);
+            flush();
         }
         else {
-            if (root->keys.size() == 1) {
-                BPlusInternalNode<KeyType>* tmp = static_cast<BPlusInternalNode<KeyType>*>(root);
-                root = tmp->children[0];
-                delete tmp;
+            if (pread(fd, &meta, sizeof(meta), 0) != static_cast<ssize_t>(sizeof(meta)) ||
+                meta.magic != kMagic || meta.pageSize != pageSize) {
+                close(fd);
+                throw std::runtime_error("PagedBPlusTree: bad file header");
             }
         }
     }
 
-    // 遍历叶子链表，调试用
-    void traverseLeaves() {
-        // 找到最左叶
-        BPlusNode<KeyType>* cur = root;
-        if (!cur) {
-            std::cout << "Empty B+ tree\n";
-            return;
+    ~PagedBPlusTree() {
+        // 析构中不能再抛出异常，需要确认落盘的调用方应先显式 flush()
+        try {
+            flush();
         }
-        while (!cur->isLeaf) {
-            cur = static_cast<BPlusInternalNode<KeyType>*>(cur)->children[0];
+        catch (const std::exception&) {
         }
-        BPlusLeafNode<KeyType>* leaf = static_cast<BPlusLeafNode<KeyType>*>(cur);
-        // 顺序打印所有叶
-        while (leaf) {
-            std::cout << "[";
-            for (auto& k : leaf->keys) std::cout << k << " ";
-            std::cout << "] -> ";
-            leaf = leaf->next;
+        pool.reset();
+        close(fd);
+    }
+
+    PagedBPlusTree(const PagedBPlusTree&) = delete;
+    PagedBPlusTree& operator=(const PagedBPlusTree&) = delete;
+
+    bool find(const KeyType& k, ValueType& out) {
+        PageId pid = meta.root;
+        for (;;) {
+            char* page = pool->pin(pid);
+            PageHeader* h = header(page);
+            size_t idx = nodeLowerBound(keys(page), h->count, k);
+            if (h->isLeaf) {
+                bool found = idx < h->count && keys(page)[idx] == k;
+                if (found) out = values(page)[idx];
+                pool->unpin(pid, false);
+                return found;
+            }
+            PageId child = children(page)[idx];
+            pool->unpin(pid, false);
+            pid = child;
         }
-        std::cout << "NULL\n";
     }
 
-    // 遍历
-    void traverse() {
-        if (root) root->traverse();
-        else std::cout << "Empty tree\n";
+    // k 不存在则插入，存在则覆盖；返回是否新插入
+    bool insert_or_assign(const KeyType& k, const ValueType& v) {
+        char* rootPage = pool->pin(meta.root);
+        if (isFull(rootPage)) {
+            // 根满了：新根只有一个孩子，再分裂旧根
+            PageId oldRoot = meta.root;
+            PageId newRoot = allocPage();
+            char* page = pool->pinNew(newRoot);
+            children(page)[0] = oldRoot;
+            splitChild(page, 0, rootPage);
+            pool->unpin(oldRoot, true);
+            meta.root = newRoot;
+            meta.height++;
+            rootPage = page;
+        }
+        PageId pid = meta.root;
+        char* page = rootPage;
+        bool dirty = false; // 新根由 pinNew 已标脏
+        while (!header(page)->isLeaf) {
+            size_t idx = nodeLowerBound(keys(page), header(page)->count, k);
+            PageId childPid = children(page)[idx];
+            char* child = pool->pin(childPid);
+            bool childDirty = false;
+            if (isFull(child)) {
+                splitChild(page, idx, child);
+                dirty = childDirty = true;
+                // 分裂后 k 可能落在右半
+                if (keys(page)[idx] < k) {
+                    pool->unpin(childPid, true);
+                    childPid = children(page)[idx + 1];
+                    child = pool->pin(childPid);
+                    childDirty = false;
+                }
+            }
+            pool->unpin(pid, dirty);
+            pid = childPid;
+            page = child;
+            dirty = childDirty;
+        }
+        PageHeader* h = header(page);
+        size_t idx = nodeLowerBound(keys(page), h->count, k);
+        bool inserted = !(idx < h->count && keys(page)[idx] == k);
+        if (inserted) {
+            std::memmove(keys(page) + idx + 1, keys(page) + idx, (h->count - idx) * sizeof(KeyType));
+            std::memmove(values(page) + idx + 1, values(page) + idx, (h->count - idx) * sizeof(ValueType));
+            keys(page)[idx] = k;
+            h->count++;
+        }
+        values(page)[idx] = v;
+        pool->unpin(pid, true);
+        return inserted;
+    }
+
+    // 返回 k 是否存在
+    bool erase(const KeyType& k) {
+        PageId pid = meta.root;
+        for (;;) {
+            char* page = pool->pin(pid);
+            PageHeader* h = header(page);
+            size_t idx = nodeLowerBound(keys(page), h->count, k);
+            if (h->isLeaf) {
+                bool found = idx < h->count && keys(page)[idx] == k;
+                if (found) {
+                    std::memmove(keys(page) + idx, keys(page) + idx + 1, (h->count - idx - 1) * sizeof(KeyType));
+                    std::memmove(values(page) + idx, values(page) + idx + 1, (h->count - idx - 1) * sizeof(ValueType));
+                    h->count--;
+                }
+                pool->unpin(pid, found);
+                return found;
+            }
+            PageId child = children(page)[idx];
+            pool->unpin(pid, false);
+            pid = child;
+        }
+    }
+
+    // 写回所有脏页和元数据页
+    void flush() {
+        pool->flushAll();
+        if (pwrite(fd, &meta, sizeof(meta), 0) != static_cast<ssize_t>(sizeof(meta)))
+            throw std::runtime_error("PagedBPlusTree: cannot write header");
+    }
+
+    size_t height() const { return meta.height; }
+    size_t pageReads() const { return pool->pageReads(); }
+    size_t pageWrites() const { return pool->pageWrites(); }
+
+private:
+    static constexpr uint64_t kMagic = 0x3145455254505042ULL;  // "BPPTREE1"
+
+    // 第 0 页开头
+    struct Meta {
+        uint64_t magic;
+        uint64_t pageSize;
+        PageId root;
+        PageId nextPage;  // 下一个未分配的页号
+        uint64_t height = 1;
+    };
+
+    // 节点页布局：页头 | keys[cap] | values[cap] 或 children[cap+1]
+    // keys 和 children 分开存放；内部节点 children[i] 中的 key 都 <= keys[i] < children[i+1] 中的 key
+    struct PageHeader {
+        uint32_t isLeaf;
+        uint32_t count;
+        PageId next;  // 叶子的右兄弟页号，0 表示没有
+    };
+
+    int fd;
+    size_t pageSize;
+    size_t leafCap, innerCap;
+    size_t valuesOffset, childrenOffset;
+    Meta meta;
+    std::unique_ptr<BufferPool> pool;
+
+    static PageHeader* header(char* page) { return reinterpret_cast<PageHeader*>(page); }
+    static KeyType* keys(char* page) { return reinterpret_cast<KeyType*>(page + sizeof(PageHeader)); }
+    ValueType* values(char* page) const { return reinterpret_cast<ValueType*>(page + valuesOffset); }
+    PageId* children(char* page) const { return reinterpret_cast<PageId*>(page + childrenOffset); }
+
+    // 一页能放下的 key 数：页头 + cap 个 key + 按对齐放置的 cap + extra 个 value/页号
+    size_t layout(size_t itemSize, size_t itemAlign, size_t extra, size_t& offset) const {
+        size_t cap = (pageSize - sizeof(PageHeader) - extra * itemSize) / (sizeof(KeyType) + itemSize);
+        for (; cap > 0; --cap) {
+            offset = (sizeof(PageHeader) + cap * sizeof(KeyType) + itemAlign - 1) / itemAlign * itemAlign;
+            if (offset + (cap + extra) * itemSize <= pageSize) break;
+        }
+        return cap;
+    }
+    bool isFull(char* page) const {
+        PageHeader* h = header(page);
+        return h->count >= (h->isLeaf ? leafCap : innerCap);
+    }
+
+    PageId allocPage() { return meta.nextPage++; }
+
+    // 分裂已 pin 的满节点 child（为 parent 的第 idx 个孩子），新右半页号和分隔 key 插入 parent
+    void splitChild(char* parent, size_t idx, char* child) {
+        PageHeader* ch = header(child);
+        PageId rightPid = allocPage();
+        char* right = pool->pinNew(rightPid);
+        PageHeader* rh = header(right);
+        rh->isLeaf = ch->isLeaf;
+        size_t n = ch->count;
+        size_t mid = n / 2;
+        KeyType sep;
+        if (ch->isLeaf) {
+            rh->count = static_cast<uint32_t>(n - mid);
+            std::memcpy(keys(right), keys(child) + mid, rh->count * sizeof(KeyType));
+            std::memcpy(values(right), values(child) + mid, rh->count * sizeof(ValueType));
+            ch->count = static_cast<uint32_t>(mid);
+            sep = keys(child)[mid - 1];
+            rh->next = ch->next;
+            ch->next = rightPid;
+        }
+        else {
+            // 中间 key 上移，不留在左右两半
+            rh->count = static_cast<uint32_t>(n - mid - 1);
+            std::memcpy(keys(right), keys(child) + mid + 1, rh->count * sizeof(KeyType));
+            std::memcpy(children(right), children(child) + mid + 1, (rh->count + 1) * sizeof(PageId));
+            ch->count = static_cast<uint32_t>(mid);
+            sep = keys(child)[mid];
+        }
+        pool->unpin(rightPid, true);
+
+        PageHeader* ph = header(parent);
+        std::memmove(keys(parent) + idx + 1, keys(parent) + idx, (ph->count - idx) * sizeof(KeyType));
+        std::memmove(children(parent) + idx + 2, children(parent) + idx + 1, (ph->count - idx) * sizeof(PageId));
+        keys(parent)[idx] = sep;
+        children(parent)[idx + 1] = rightPid;
+        ph->count++;
     }
 };
+#endif
 
+// 编译时定义 BTREE_NO_MAIN 则不生成演示用的 main，供基准程序（BTreeAndBPlusTreeBench.cpp）直接包含本文件
+#ifndef BTREE_NO_MAIN
 int main() {
     {
         int t = 10; // 最小度数
@@ -738,6 +5493,14 @@ int main() {
         tree.traverse();
         tree.traverseLeaves();
 
+        // 区间扫描示例
+        std::cout << "Range [1, 12): ";
+        auto r = tree.range(1, 12);
+        for (int k : r) std::cout << k << " ";
+        std::cout << "\nReverse: ";
+        for (auto it = r.rbegin(); it != r.rend(); ++it) std::cout << *it << " ";
+        std::cout << "\n";
+
         std::cout << "-------------------\n";
         for (int i = 1; i <= keysToInsert.size(); ++i) {
             //std::cout << "\n\n-------------------";
@@ -750,7 +5513,8 @@ int main() {
                 std::cout << "Key " << searchKey << " not found.\n";
             }
             // 删除示例
-            tree.remove(searchKey);
+            if (!tree.remove(searchKey))
+                std::cout << "Key " << searchKey << " does not exist in the tree\n";
             std::cout << "After removing " << searchKey << ":\n";
             tree.traverse();
             std::cout << "---------\n";
@@ -760,5 +5524,224 @@ int main() {
         std::cout << "---------\n";
         tree.traverseLeaves();
     }
+
+    {
+        // 从有序数据批量构建
+        std::vector<int> sortedKeys(30);
+        std::iota(sortedKeys.begin(), sortedKeys.end(), 1);
+        BPlusTree<int> tree(3);
+        tree.bulkLoad(sortedKeys.begin(), sortedKeys.end(), 0.7);
+        std::cout << "Bulk loaded B+ tree:\n";
+        tree.traverse();
+        tree.traverseLeaves();
+
+        BTree<int> btree(3);
+        btree.bulkLoad(sortedKeys.begin(), sortedKeys.end(), 0.7);
+        std::cout << "Bulk loaded B tree:\n";
+        btree.traverse();
+    }
+
+    {
+        // key/value 示例
+        BPlusTree<int, std::string> dict(3);
+        for (int i = 1; i <= 20; ++i)
+            dict.insert_or_assign(i, "v" + std::to_string(i));
+        dict.emplace(5, "ignored");  // 已存在，不覆盖
+        dict.insert_or_assign(6, "six");
+        dict.erase(7);
+        if (std::string* v = dict.find(6))
+            std::cout << "find(6) = " << *v << "\n";
+        for (auto it = dict.lower_bound(4); it != dict.lower_bound(9); ++it)
+            std::cout << it.key() << "=" << it.value() << " ";
+        std::cout << "\n";
+
+        // 批量插入和查找
+        std::vector<std::pair<int, std::string>> batch = { { 30, "v30" }, { 7, "seven" }, { 25, "v25" } };
+        dict.insertBatch(batch.begin(), batch.end());
+        int queries[] = { 25, 7, 99, 30 };
+        std::string* found[4];
+        dict.findBatch(queries, 4, found);
+        for (int i = 0; i < 4; ++i)
+            std::cout << queries[i] << "=" << (found[i] ? *found[i] : "(none)") << " ";
+        std::cout << "\n";
+    }
+
+    {
+        // 字符串 key：节点内只存一份公共前缀
+        BPlusTree<std::string> urls(4);
+        for (int i = 0; i < 100; ++i)
+            urls.insert("https://example.com/item/" + std::to_string(i));
+        std::cout << "URL tree: " << (urls.search("https://example.com/item/42") ? "found" : "missing")
+            << " item/42, first " << *urls.begin() << "\n";
+    }
+
+    {
+        // 统计快照：结构信息总能拿到，操作计数需以 -DBTREE_STATS=1 编译
+        BPlusTree<int> tree(16);
+        std::vector<int> keys(100000);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+        for (int k : keys) tree.insert(k);
+        for (size_t i = 0; i < keys.size(); i += 2) tree.erase(keys[i]);
+        for (int k = 0; k < 1000; ++k) tree.search(k);
+        tree.stats().print(std::cout);
+        // 按序号定位：中位数、p99 和某个 key 的排名
+        std::cout << "size " << tree.size() << ", median " << *tree.select(tree.size() / 2) << ", p99 "
+            << *tree.select(tree.size() * 99 / 100) << ", rank(50000) " << tree.rank(50000) << "\n";
+    }
+
+    {
+        // 编译期度数：按 key/value 大小让节点不超过 8 条缓存行
+        FixedBPlusTree<double, bplusDegreeFor<double, int>(), int> tree;
+        for (int i = 0; i < 1000; ++i) tree.insert_or_assign(i * 0.5, i);
+        std::cout << "Fixed degree " << tree.t << ": find(250) = " << *tree.find(250.0)
+            << ", height " << tree.stats().height << "\n";
+    }
+
+    {
+        // 建好后只读：冻结成无指针的连续布局
+        BPlusTree<int, int> tree(16);
+        for (int i = 0; i < 100000; ++i) tree.insert_or_assign(i * 3, i);
+        auto frozen = tree.freeze();
+        const int* v = frozen.find(300);
+        std::cout << "Frozen: find(300) = " << (v ? *v : -1) << ", height " << frozen.height() << ", "
+            << frozen.bytes() << " bytes vs " << tree.stats().bytes << " in nodes\n";
+    }
+
+    {
+        // 快照：保存后重启时直接整块载入，不再逐个插入
+        const char* path = "bplus_snapshot_demo.bin";
+        BPlusTree<int, int> tree(8);
+        for (int i = 0; i < 50000; ++i) tree.insert_or_assign(i * 7 % 50000, i);
+        tree.save(path);
+        BPlusTree<int, int> restored(8);
+        restored.load(path);
+        std::cout << "Snapshot restored " << restored.size() << " entries, find(49) = " << *restored.find(49) << "\n";
+        std::remove(path);
+    }
+
+    {
+        // 整段删除、切分与拼接：按时间戳淘汰过期数据，把较新的一半移到另一棵树再接回来
+        BPlusTree<int, int> tree(8);
+        for (int i = 0; i < 100000; ++i) tree.insert_or_assign(i, i);
+        size_t expired = tree.eraseRange(0, 30000);
+        BPlusTree<int, int> recent(8);
+        tree.splitAt(80000, recent);
+        std::cout << "eraseRange removed " << expired << ", split into " << tree.size() << " + " << recent.size();
+        tree.join(recent);
+        std::cout << ", joined back " << tree.size() << ", select(0) = " << *tree.select(0) << "\n";
+    }
+
+    {
+        // 多值映射：二级索引里 status 取值很少，每个取值对应大量行号
+        BPlusMultiMap<int> byStatus(8);
+        for (uint64_t row = 0; row < 100000; ++row) byStatus.insert(row % 10 == 0 ? 1 : 0, row);
+        byStatus.erase(1, 50);
+        uint64_t sum = 0;
+        for (uint64_t row : *byStatus.find(1)) sum += row;
+        std::cout << "Multimap: " << byStatus.keyCount() << " keys, " << byStatus.size() << " rows, status 1 has "
+            << byStatus.count(1) << " rows (sum " << sum << ") in " << byStatus.find(1)->bytes() << " bytes\n";
+    }
+
+    {
+        // 差值压缩的整数 key：自增主键几乎连续，节点内 key 只存 16 位差值
+        BPlusTree<int64_t> plain(32);
+        PackedBPlusTree<int64_t> packed(32);
+        for (int64_t i = 0; i < 200000; ++i) {
+            plain.insert(i * 3);
+            packed.insert(i * 3);
+        }
+        packed.insert(INT64_MAX);
+        std::cout << "Packed keys: " << packed.stats().bytes << " bytes vs " << plain.stats().bytes
+            << ", search(600) " << (packed.search(600) ? "hit" : "miss") << ", search(601) " << (packed.search(601) ? "hit" : "miss")
+            << ", last = " << *std::prev(packed.end()) << "\n";
+    }
+
+    {
+        // 多线程读写示例：每个线程写自己的一段 key，同时查其他线程的 key
+        ConcurrentBPlusTree<int, int> ctree(8);
+        const int nThreads = 4, perThread = 10000;
+        std::vector<std::thread> workers;
+        for (int id = 0; id < nThreads; ++id) {
+            workers.emplace_back([&ctree, id] {
+                for (int i = 0; i < perThread; ++i) {
+                    int k = i * nThreads + id;
+                    ctree.insert_or_assign(k, k * 2);
+                    int v;
+                    ctree.find((k + 1) % (perThread * nThreads), v);
+                }
+                for (int i = 0; i < perThread; i += 2)
+                    ctree.erase(i * nThreads + id);
+            });
+        }
+        for (auto& w : workers) w.join();
+        int found = 0;
+        for (int k = 0; k < nThreads * perThread; ++k) {
+            int v;
+            if (ctree.find(k, v) && v == k * 2) ++found;
+        }
+        std::cout << "Concurrent tree holds " << found << " keys\n";
+    }
+
+    {
+        // 多版本快照：分析线程对某一时刻的数据做汇总，写线程同时继续写入
+        CowBPlusTree<int, int> mvcc(8);
+        mvcc.update([](auto& w) {
+            for (int i = 0; i < 10000; ++i) w.insert_or_assign(i, 1);
+        });
+        auto snap = mvcc.snapshot();
+        std::thread writer([&mvcc] {
+            for (int i = 0; i < 10000; ++i) mvcc.insert_or_assign(i, 2);
+            for (int i = 0; i < 5000; ++i) mvcc.erase(i);
+        });
+        long long sum = 0;
+        snap.forEach([&sum](int, int v) { sum += v; });
+        writer.join();
+        int now = 0;
+        mvcc.find(9999, now);
+        std::cout << "MVCC snapshot v" << snap.version() << " sums " << sum << " over " << snap.size()
+            << " keys; now " << mvcc.size() << " keys, find(9999) = " << now << "\n";
+    }
+
+    {
+        // 分片：四个区间各由一个线程独占，批量写入拆给各分片并行执行；
+        // 写入全落在最后一个分片上，rebalance 把边界往后移
+        ShardedBPlusTree<int, int> sharded(8, { 1000, 2000, 3000 });
+        std::vector<std::future<size_t>> pending;
+        for (int b = 0; b < 20; ++b) {
+            std::vector<std::pair<int, int>> items;
+            for (int i = 0; i < 1000; ++i) items.emplace_back(3000 + b * 1000 + i, i);
+            pending.push_back(sharded.insertBatch(std::move(items)));
+        }
+        size_t inserted = 0;
+        for (auto& f : pending) inserted += f.get();
+        while (sharded.rebalance()) {}
+        auto hits = sharded.findBatch({ 3000, 12345, 22999, 23000 }).get();
+        std::cout << "Sharded tree inserted " << inserted << ", hits " << std::count_if(hits.begin(), hits.end(),
+            [](const auto& h) { return h.has_value(); }) << "/4, bounds";
+        for (int b : sharded.boundaries()) std::cout << " " << b;
+        std::cout << "\n";
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        // 磁盘 B+ 树：缓冲池只有 64 页，数据量远大于缓冲池
+        const char* path = "paged_bplus_demo.db";
+        std::remove(path);
+        {
+            PagedBPlusTree<int, int> disk(path, 64);
+            for (int i = 0; i < 200000; ++i)
+                disk.insert_or_assign(i, i * 2);
+        }
+        PagedBPlusTree<int, int> disk(path, 64);
+        size_t before = disk.pageReads();
+        int v = 0, hits = 0;
+        for (int i = 0; i < 200000; i += 97)
+            hits += disk.find(i, v) && v == i * 2;
+        std::cout << "Paged tree height " << disk.height() << ", " << hits << " hits, "
+            << double(disk.pageReads() - before) / hits << " page reads per lookup\n";
+        std::remove(path);
+    }
+#endif
     return 0;
 }
+#endif
@@ -0,0 +1,508 @@
+// BTree / BPlusTree 与 std::set / std::map 的对比基准。
+// 负载：插入、查找、删除、范围扫描、混合；key 顺序：均匀随机、顺序、Zipf、对抗（两端交替）；
+// 对每个 n 扫描不同的最小度数 t。报告吞吐、p50/p99 延迟、峰值 RSS 增量和每 key 字节数，
+// 每次运行的结果（命中、返回值、扫描和、最终内容）都与同负载下的 std::set / std::map 比对。
+//
+// 编译：g++ -std=c++17 -O2 -march=native -pthread BTreeAndBPlusTreeBench.cpp -o btree_bench
+// 运行：./btree_bench [n=1e3,1e4,1e5,1e6] [t=4,16,64] [order=uniform,sequential,zipf,adversarial]
+//                     [op=insert,find,erase,scan,mixed] [struct=set,btree,map,bplus]
+//                     [sample=16] [verify=1] [seed=1]
+// BTree 只存 key，与 std::set 对比；BPlusTree<int64_t, int64_t> 与 std::map 对比。
+// 每 sample 个操作单独计时一次，延迟含一次 steady_clock 读数的开销。
+// 峰值 RSS 在 Linux 上通过 /proc/self/clear_refs 逐次清零，其他平台不报告
+#define BTREE_NO_MAIN
+#include "BTreeAndBPlusTree.cpp"
+#include <map>
+#include <set>
+#include <cmath>
+#include <sstream>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// std::set / std::map 的节点字节数
+size_t stdBytes = 0;
+
+template<typename T>
+struct CountingAlloc {
+    using value_type = T;
+    CountingAlloc() = default;
+    template<typename U>
+    CountingAlloc(const CountingAlloc<U>&) {}
+    T* allocate(size_t n) {
+        stdBytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        stdBytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+    template<typename U>
+    bool operator==(const CountingAlloc<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const CountingAlloc<U>&) const { return false; }
+};
+
+#if defined(__linux__)
+// /proc/self/status 中某一项，单位 KB
+size_t statusKb(const char* field) {
+    FILE* f = std::fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    char line[256];
+    size_t kb = 0, len = std::strlen(field);
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, field, len) == 0) {
+            kb = std::strtoull(line + len + 1, nullptr, 10);
+            break;
+        }
+    }
+    std::fclose(f);
+    return kb;
+}
+// 把峰值 RSS 重置为当前 RSS，返回当前 RSS；内核不支持时峰值照旧累计。
+// 先把上一次运行释放的堆内存还给系统，否则这次运行复用它们时不计入增量
+size_t resetPeakRss() {
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    if (FILE* f = std::fopen("/proc/self/clear_refs", "w")) {
+        std::fputs("5", f);
+        std::fclose(f);
+    }
+    return statusKb("VmRSS");
+}
+size_t peakRss() { return statusKb("VmHWM"); }
+#else
+size_t resetPeakRss() { return 0; }
+size_t peakRss() { return 0; }
+#endif
+
+// 以下适配器把各容器统一成同一组操作；set 类容器的 value 即 key
+struct StdSet {
+    static constexpr const char* name = "std::set";
+    std::set<int64_t, std::less<int64_t>, CountingAlloc<int64_t>> s;
+    explicit StdSet(int) {}
+    bool upsert(int64_t k, int64_t) { return s.insert(k).second; }
+    bool find(int64_t k, int64_t& v) {
+        auto it = s.find(k);
+        if (it == s.end()) return false;
+        v = *it;
+        return true;
+    }
+    bool erase(int64_t k) { return s.erase(k) > 0; }
+    uint64_t scan(int64_t lo, size_t len) {
+        uint64_t sum = 0;
+        auto it = s.lower_bound(lo);
+        for (size_t i = 0; i < len && it != s.end(); ++i, ++it) sum += uint64_t(*it) * 2;
+        return sum;
+    }
+    bool canScan() const { return true; }
+    size_t bytes() const { return stdBytes; }
+};
+
+struct BTreeSet {
+    static constexpr const char* name = "BTree";
+    BTree<int64_t> tree;
+    explicit BTreeSet(int t) : tree(t) {}
+    // BTree::insert 不查重，先查一次
+    bool upsert(int64_t k, int64_t) {
+        if (tree.search(k)) return false;
+        tree.insert(k);
+        return true;
+    }
+    bool find(int64_t k, int64_t& v) {
+        if (!tree.search(k)) return false;
+        v = k;
+        return true;
+    }
+    bool erase(int64_t k) { return tree.remove(k); }
+    // BTree 没有有序迭代
+    uint64_t scan(int64_t, size_t) { return 0; }
+    bool canScan() const { return false; }
+    size_t bytes() const { return tree.stats().bytes; }
+};
+
+struct StdMap {
+    static constexpr const char* name = "std::map";
+    std::map<int64_t, int64_t, std::less<int64_t>, CountingAlloc<std::pair<const int64_t, int64_t>>> m;
+    explicit StdMap(int) {}
+    bool upsert(int64_t k, int64_t v) { return m.insert_or_assign(k, v).second; }
+    bool find(int64_t k, int64_t& v) {
+        auto it = m.find(k);
+        if (it == m.end()) return false;
+        v = it->second;
+        return true;
+    }
+    bool erase(int64_t k) { return m.erase(k) > 0; }
+    uint64_t scan(int64_t lo, size_t len) {
+        uint64_t sum = 0;
+        auto it = m.lower_bound(lo);
+        for (size_t i = 0; i < len && it != m.end(); ++i, ++it) sum += uint64_t(it->first) + uint64_t(it->second);
+        return sum;
+    }
+    bool canScan() const { return true; }
+    size_t bytes() const { return stdBytes; }
+};
+
+struct BPlusMap {
+    static constexpr const char* name = "BPlusTree";
+    BPlusTree<int64_t, int64_t> tree;
+    explicit BPlusMap(int t) : tree(t) {}
+    bool upsert(int64_t k, int64_t v) { return tree.insert_or_assign(k, v); }
+    bool find(int64_t k, int64_t& v) {
+        int64_t* p = tree.find(k);
+        if (!p) return false;
+        v = *p;
+        return true;
+    }
+    bool erase(int64_t k) { return tree.erase(k); }
+    uint64_t scan(int64_t lo, size_t len) {
+        uint64_t sum = 0;
+        auto it = tree.lower_bound(lo), end = tree.end();
+        for (size_t i = 0; i < len && it != end; ++i, ++it) sum += uint64_t(it.key()) + uint64_t(it.value());
+        return sum;
+    }
+    bool canScan() const { return true; }
+    size_t bytes() const { return tree.stats().bytes; }
+};
+
+enum class Order { Uniform, Sequential, Zipf, Adversarial };
+enum class Op { Insert, Find, Erase, Scan, Mixed };
+const char* orderNames[] = { "uniform", "sequential", "zipf", "adversarial" };
+const char* opNames[] = { "insert", "find", "erase", "scan", "mixed" };
+
+// 第 i 个 key 为 2i，奇数一定不存在，用作查找未命中
+inline int64_t keyAt(size_t i) { return int64_t(i) * 2; }
+
+// Zipf(θ) 分布的排名 [0, n)，取自 YCSB 的 ZipfianGenerator；zeta(n) 预先算好
+class Zipf {
+public:
+    Zipf(size_t _n, double _theta = 0.99) : n(_n), theta(_theta) {
+        double zeta2 = 1 + std::pow(0.5, theta);
+        zetan = 0;
+        for (size_t i = 1; i <= n; ++i) zetan += 1 / std::pow(double(i), theta);
+        alpha = 1 / (1 - theta);
+        eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+    template<typename Rng>
+    size_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan;
+        if (uz < 1) return 0;
+        if (uz < 1 + std::pow(0.5, theta)) return std::min<size_t>(1, n - 1);
+        return std::min(n - 1, size_t(n * std::pow(eta * u - eta + 1, alpha)));
+    }
+private:
+    size_t n;
+    double theta, zetan, alpha, eta;
+};
+
+// 长为 count 的 key 下标序列。uniform/sequential/adversarial 在 count == n 时是 0..n-1 的排列；
+// zipf 的热点排名经一个固定的随机排列映射到下标，热点 key 散布在整个范围内
+std::vector<size_t> indexSequence(Order order, size_t n, size_t count, std::mt19937_64& rng) {
+    std::vector<size_t> seq(count);
+    switch (order) {
+    case Order::Uniform: {
+        if (count == n) {
+            std::iota(seq.begin(), seq.end(), size_t(0));
+            std::shuffle(seq.begin(), seq.end(), rng);
+        }
+        else {
+            for (auto& x : seq) x = rng() % n;
+        }
+        break;
+    }
+    case Order::Sequential:
+        for (size_t i = 0; i < count; ++i) seq[i] = i % n;
+        break;
+    case Order::Zipf: {
+        std::vector<size_t> perm(n);
+        std::iota(perm.begin(), perm.end(), size_t(0));
+        std::shuffle(perm.begin(), perm.end(), rng);
+        Zipf z(n);
+        for (auto& x : seq) x = perm[z(rng)];
+        break;
+    }
+    case Order::Adversarial:
+        // 两端交替：最小、最大、次小、次大……，两侧边缘叶子轮流分裂或合并
+        for (size_t i = 0; i < count; ++i) {
+            size_t j = (i / 2) % ((n + 1) / 2);
+            seq[i] = (i % 2 == 0) ? j : n - 1 - j;
+        }
+        break;
+    }
+    return seq;
+}
+
+struct Result {
+    double mops = 0;
+    uint64_t p50 = 0, p99 = 0;  // ns
+    size_t peakKb = 0;
+    double bytesPerKey = 0;
+    uint64_t checksum = 0;
+    bool supported = true;
+};
+
+inline void mix(uint64_t& h, uint64_t x) { h = (h ^ x) * 0x100000001b3ULL + 0x9e3779b97f4a7c15ULL; }
+
+struct Config {
+    std::vector<size_t> sizes{ 1000, 10000, 100000, 1000000 };
+    std::vector<int> degrees{ 4, 16, 64 };
+    std::vector<Order> orders{ Order::Uniform, Order::Sequential, Order::Zipf, Order::Adversarial };
+    std::vector<Op> ops{ Op::Insert, Op::Find, Op::Erase, Op::Scan, Op::Mixed };
+    std::vector<std::string> structs{ "set", "btree", "map", "bplus" };
+    size_t sample = 16;
+    bool verify = true;
+    uint64_t seed = 1;
+};
+
+// 一次运行的输入：预填充的下标序列和计时部分的下标序列，各容器共用同一份
+struct Workload {
+    Op op;
+    size_t n;
+    std::vector<size_t> fill;  // 计时前插入
+    std::vector<size_t> seq;   // 计时部分每个操作的 key 下标
+    std::vector<uint8_t> kind; // mixed 中每个操作的类型
+};
+
+Workload makeWorkload(Op op, Order order, size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    Workload w{ op, n, {}, {}, {} };
+    if (op != Op::Insert) w.fill = indexSequence(Order::Uniform, n, n, rng);
+    size_t count = op == Op::Scan ? std::max<size_t>(1, n / 16) : n;
+    w.seq = indexSequence(order, n, count, rng);
+    if (op == Op::Mixed) {
+        // 50% 查找，25% 写入，25% 删除
+        w.kind.resize(count);
+        for (auto& k : w.kind) {
+            size_t r = rng() % 4;
+            k = r < 2 ? 0 : r == 2 ? 1 : 2;
+        }
+    }
+    return w;
+}
+
+template<typename C>
+Result run(C& c, const Workload& w, size_t sample) {
+    Result r;
+    if (w.op == Op::Scan && !c.canScan()) {
+        r.supported = false;
+        return r;
+    }
+    for (size_t i : w.fill) c.upsert(keyAt(i), int64_t(i));
+    if (w.op != Op::Insert) r.bytesPerKey = double(c.bytes()) / w.n;
+
+    std::vector<uint64_t> lat;
+    lat.reserve(w.seq.size() / sample + 1);
+    uint64_t h = 0;
+    size_t kb0 = resetPeakRss();
+    auto once = [&](size_t j) {
+        size_t i = w.seq[j];
+        int64_t v = 0;
+        switch (w.op) {
+        case Op::Insert:
+            mix(h, c.upsert(keyAt(i), int64_t(i)));
+            break;
+        case Op::Find: {
+            // 每 4 次有 1 次查奇数 key，必定未命中
+            bool miss = (j & 3) == 3;
+            bool found = c.find(keyAt(i) + (miss ? 1 : 0), v);
+            mix(h, found ? uint64_t(v) : ~uint64_t(0));
+            break;
+        }
+        case Op::Erase:
+            mix(h, c.erase(keyAt(i)));
+            break;
+        case Op::Scan:
+            mix(h, c.scan(keyAt(i), 64));
+            break;
+        case Op::Mixed:
+            switch (w.kind[j]) {
+            case 0: mix(h, c.find(keyAt(i), v) ? uint64_t(v) : ~uint64_t(0)); break;
+            case 1: mix(h, c.upsert(keyAt(i), int64_t(j))); break;
+            default: mix(h, c.erase(keyAt(i))); break;
+            }
+            break;
+        }
+    };
+    auto start = Clock::now();
+    for (size_t j = 0; j < w.seq.size(); ++j) {
+        if (j % sample == 0) {
+            auto a = Clock::now();
+            once(j);
+            lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a).count());
+        }
+        else {
+            once(j);
+        }
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t kb1 = peakRss();
+    r.peakKb = kb1 > kb0 ? kb1 - kb0 : 0;
+    r.mops = w.seq.size() / secs / 1e6;
+    if (!lat.empty()) {
+        auto pct = [&](double q) {
+            size_t k = std::min(lat.size() - 1, size_t(q * lat.size()));
+            std::nth_element(lat.begin(), lat.begin() + k, lat.end());
+            return lat[k];
+        };
+        r.p50 = pct(0.50);
+        r.p99 = pct(0.99);
+    }
+    if (w.op == Op::Insert) {
+        // zipf 插入有重复，按实际 key 数算
+        size_t distinct = 0;
+        int64_t v;
+        for (size_t i = 0; i < w.n; ++i) distinct += c.find(keyAt(i), v);
+        r.bytesPerKey = distinct ? double(c.bytes()) / distinct : 0;
+    }
+    r.checksum = h;
+    return r;
+}
+
+// 最终内容比对：每个 key 的有无和 value 都要与参照容器一致
+template<typename C, typename Ref>
+bool sameContents(C& c, Ref& ref, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        int64_t a = 0, b = 0;
+        bool fa = c.find(keyAt(i), a), fb = ref.find(keyAt(i), b);
+        if (fa != fb || (fa && a != b)) return false;
+    }
+    return true;
+}
+
+void printRow(const char* op, const char* order, size_t n, const char* name, int t, const Result& r, const char* check) {
+    if (!r.supported) {
+        std::printf("%-7s %-12s %10zu %-10s %4s %9s %8s %8s %10s %8s  %s\n", op, order, n, name,
+                    t ? std::to_string(t).c_str() : "-", "n/a", "-", "-", "-", "-", "-");
+        return;
+    }
+    std::printf("%-7s %-12s %10zu %-10s %4s %9.2f %8llu %8llu %10.1f %8.1f  %s\n", op, order, n, name,
+                t ? std::to_string(t).c_str() : "-", r.mops, (unsigned long long)r.p50, (unsigned long long)r.p99,
+                r.peakKb / 1024.0, r.bytesPerKey, check);
+}
+
+bool wants(const Config& cfg, const char* s) {
+    return std::find(cfg.structs.begin(), cfg.structs.end(), s) != cfg.structs.end();
+}
+
+// 先跑参照容器 Ref，再对每个 t 跑 Tree 并比对；返回是否全部一致
+template<typename Ref, typename Tree>
+bool compare(const Config& cfg, const Workload& w, Order order, const char* refKey, const char* treeKey) {
+    bool ok = true;
+    const char* op = opNames[size_t(w.op)];
+    const char* ord = orderNames[size_t(order)];
+    bool runRef = wants(cfg, refKey) || (cfg.verify && wants(cfg, treeKey));
+    std::unique_ptr<Ref> ref;
+    Result rr;
+    if (runRef) {
+        ref.reset(new Ref(0));
+        rr = run(*ref, w, cfg.sample);
+        if (wants(cfg, refKey)) printRow(op, ord, w.n, Ref::name, 0, rr, "ref");
+    }
+    if (!wants(cfg, treeKey)) return ok;
+    for (int t : cfg.degrees) {
+        std::unique_ptr<Tree> tree(new Tree(t));
+        Result r = run(*tree, w, cfg.sample);
+        const char* check = "-";
+        if (cfg.verify && r.supported) {
+            bool same = r.checksum == rr.checksum && sameContents(*tree, *ref, w.n);
+            check = same ? "ok" : "MISMATCH";
+            ok = ok && same;
+        }
+        printRow(op, ord, w.n, Tree::name, t, r, check);
+    }
+    return ok;
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+template<typename E>
+E parseName(const std::string& s, const char* const* names, size_t count, const char* what) {
+    for (size_t i = 0; i < count; ++i)
+        if (s == names[i]) return E(i);
+    throw std::invalid_argument(std::string("unknown ") + what + ": " + s);
+}
+
+Config parseArgs(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("expected key=value: " + arg);
+        std::string key = arg.substr(0, eq);
+        auto values = splitList(arg.substr(eq + 1));
+        if (values.empty()) throw std::invalid_argument("empty value: " + arg);
+        if (key == "n") {
+            cfg.sizes.clear();
+            for (auto& v : values) cfg.sizes.push_back(size_t(std::stod(v)));
+        }
+        else if (key == "t") {
+            cfg.degrees.clear();
+            for (auto& v : values) {
+                int t = std::stoi(v);
+                if (t < 2) throw std::invalid_argument("minimum degree must be at least 2");
+                cfg.degrees.push_back(t);
+            }
+        }
+        else if (key == "order") {
+            cfg.orders.clear();
+            for (auto& v : values) cfg.orders.push_back(parseName<Order>(v, orderNames, 4, "order"));
+        }
+        else if (key == "op") {
+            cfg.ops.clear();
+            for (auto& v : values) cfg.ops.push_back(parseName<Op>(v, opNames, 5, "op"));
+        }
+        else if (key == "struct") {
+            const char* names[] = { "set", "btree", "map", "bplus" };
+            for (auto& v : values) parseName<int>(v, names, 4, "struct");
+            cfg.structs = values;
+        }
+        else if (key == "sample") cfg.sample = std::max<size_t>(1, std::stoull(values[0]));
+        else if (key == "verify") cfg.verify = values[0] != "0";
+        else if (key == "seed") cfg.seed = std::stoull(values[0]);
+        else throw std::invalid_argument("unknown option: " + key);
+    }
+    return cfg;
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+    using namespace bench;
+    Config cfg;
+    try {
+        cfg = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+    std::printf("%-7s %-12s %10s %-10s %4s %9s %8s %8s %10s %8s  %s\n", "op", "order", "n", "struct", "t",
+                "Mops/s", "p50(ns)", "p99(ns)", "peakRSS+MB", "B/key", "check");
+    bool ok = true;
+    for (size_t n : cfg.sizes) {
+        for (Order order : cfg.orders) {
+            for (Op op : cfg.ops) {
+                Workload w = makeWorkload(op, order, n, cfg.seed);
+                ok = compare<StdSet, BTreeSet>(cfg, w, order, "set", "btree") && ok;
+                ok = compare<StdMap, BPlusMap>(cfg, w, order, "map", "bplus") && ok;
+            }
+        }
+    }
+    if (!ok) {
+        std::printf("verification FAILED\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+// 快速排序 (Quicksort/main.cpp) 与快速选择 (quick_select.cpp) 共用的划分引擎.
+// 逐个元素 "if (A[j] <= x)" 的划分在随机数据上约一半分支预测失败, 这里换成:
+//   blockPartition: BlockQuicksort 式无分支分块划分, 先把两端各一块中放错边的下标
+//                   无分支地记到小缓冲里, 再成批交换, 比较结果只参与算术不参与跳转;
+//   avx2Partition : int/float 的 AVX2 划分, 一次比较 8 个元素, 按掩码查表置换后
+//                   把左右两部分分别整向量写到两端 (AVX2 没有 compress store, 用置换模拟).
+#ifndef BLOCK_PARTITION_H
+#define BLOCK_PARTITION_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// 划分谓词: 返回 true 的元素放到左侧
+template<class T>
+struct LessThan {
+	T x;
+	bool operator()(const T& e) const { return e < x; }
+};
+
+template<class T>
+struct NotGreater {
+	T x;
+	bool operator()(const T& e) const { return !(x < e); }
+};
+
+const int kPartitionBlock = 64;		// 偏移缓冲长度, 下标用 unsigned char 存
+const int kNintherCutoff = 128;		// 超过此长度用 ninther 取枢轴
+
+// 划分 [first, last), 返回第一个 goesLeft 为 false 的位置
+template<class T, class Pred>
+T* blockPartition(T* first, T* last, Pred goesLeft)
+{
+	unsigned char offL[kPartitionBlock], offR[kPartitionBlock];
+	int startL = 0, numL = 0, startR = 0, numR = 0;
+	T* l = first;
+	T* r = last;
+	// 不变式: [first, l) 都属于左侧, [r, last) 都属于右侧
+	while (r - l >= 2 * kPartitionBlock) {
+		if (numL == 0) {
+			startL = 0;
+			for (int i = 0; i < kPartitionBlock; ++i) {
+				offL[numL] = (unsigned char)i;
+				numL += !goesLeft(l[i]);
+			}
+		}
+		if (numR == 0) {
+			startR = 0;
+			for (int i = 0; i < kPartitionBlock; ++i) {
+				offR[numR] = (unsigned char)i;
+				numR += goesLeft(*(r - 1 - i));
+			}
+		}
+		int num = std::min(numL, numR);
+		for (int k = 0; k < num; ++k)
+			std::swap(l[offL[startL + k]], *(r - 1 - offR[startR + k]));
+		numL -= num;
+		numR -= num;
+		startL += num;
+		startR += num;
+		if (numL == 0)
+			l += kPartitionBlock;
+		if (numR == 0)
+			r -= kPartitionBlock;
+	}
+	// 剩下不足两块 (含一块没配对完的) 用无分支 Lomuto 收尾: [l, i) 都属于右侧
+	for (T* i = l; i < r; ++i) {
+		T v = *i;
+		bool c = goesLeft(v);
+		*i = *l;
+		*l = v;
+		l += c;
+	}
+	return l;
+}
+
+#if defined(__AVX2__)
+// 8 位掩码 -> 置换下标 (每个下标 1 字节): 掩码为 1 的 lane 依次排在前, 为 0 的排在后
+struct CompressTable {
+	uint64_t idx[256];
+	CompressTable()
+	{
+		for (int m = 0; m < 256; ++m) {
+			uint64_t v = 0;
+			int k = 0;
+			for (int b = 0; b < 8; ++b)
+				if (m >> b & 1)
+					v |= uint64_t(b) << (8 * k++);
+			for (int b = 0; b < 8; ++b)
+				if (!(m >> b & 1))
+					v |= uint64_t(b) << (8 * k++);
+			idx[m] = v;
+		}
+	}
+};
+static const CompressTable kCompressTable;
+
+inline __m256i compressIndex(int mask)
+{
+	return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)kCompressTable.idx[mask]));
+}
+
+struct Avx2IntLanes {
+	typedef int T;
+	typedef __m256i V;
+	static V load(const int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void store(int* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+	static V permute(V v, __m256i idx) { return _mm256_permutevar8x32_epi32(v, idx); }
+};
+
+struct Avx2FloatLanes {
+	typedef float T;
+	typedef __m256 V;
+	static V load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+	static V permute(V v, __m256i idx) { return _mm256_permutevar8x32_ps(v, idx); }
+};
+
+// 每个谓词给出标量版本和 8 lane 掩码版本, 两者结果一致 (float 的 NaN 也一致)
+struct Avx2IntLess : Avx2IntLanes, LessThan<int> {
+	__m256i xv;
+	explicit Avx2IntLess(int x) : LessThan<int>{x}, xv(_mm256_set1_epi32(x)) {}
+	int mask(__m256i v) const { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(xv, v))); }
+};
+
+struct Avx2IntNotGreater : Avx2IntLanes, NotGreater<int> {
+	__m256i xv;
+	explicit Avx2IntNotGreater(int x) : NotGreater<int>{x}, xv(_mm256_set1_epi32(x)) {}
+	int mask(__m256i v) const { return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, xv))) & 0xFF; }
+};
+
+struct Avx2FloatLess : Avx2FloatLanes, LessThan<float> {
+	__m256 xv;
+	explicit Avx2FloatLess(float x) : LessThan<float>{x}, xv(_mm256_set1_ps(x)) {}
+	int mask(__m256 v) const { return _mm256_movemask_ps(_mm256_cmp_ps(v, xv, _CMP_LT_OQ)); }
+};
+
+struct Avx2FloatNotGreater : Avx2FloatLanes, NotGreater<float> {
+	__m256 xv;
+	explicit Avx2FloatNotGreater(float x) : NotGreater<float>{x}, xv(_mm256_set1_ps(x)) {}
+	int mask(__m256 v) const { return _mm256_movemask_ps(_mm256_cmp_ps(xv, v, _CMP_NLT_UQ)); }
+};
+
+// 原地向量划分, 要求 last - first >= 16. 先把两端各 8 个元素读进寄存器留出空位,
+// 之后总从空位较少的一端读下一组 8 个, 保证两端空位都不少于 8, 置换后整向量写到两端;
+// 最后不足 8 个的尾部连同两端预读的 16 个元素逐个放进正好剩下的空位
+template<class S>
+typename S::T* avx2Partition(typename S::T* first, typename S::T* last, const S& s)
+{
+	typedef typename S::T T;
+	typedef typename S::V V;
+	V vl = S::load(first);
+	V vr = S::load(last - 8);
+	T* wl = first;
+	T* wr = last;
+	T* rl = first + 8;
+	T* rr = last - 8;
+	while (rr - rl >= 8) {
+		V v;
+		if (rl - wl <= wr - rr) {
+			v = S::load(rl);
+			rl += 8;
+		} else {
+			rr -= 8;
+			v = S::load(rr);
+		}
+		int m = s.mask(v);
+		int c = __builtin_popcount(m);
+		V p = S::permute(v, compressIndex(m));
+		S::store(wl, p);
+		S::store(wr - 8, p);
+		wl += c;
+		wr -= 8 - c;
+	}
+	T buf[24];
+	S::store(buf, vl);
+	S::store(buf + 8, vr);
+	int n = 16;
+	while (rl < rr)
+		buf[n++] = *rl++;
+	for (int i = 0; i < n; ++i) {
+		bool c = s(buf[i]);
+		*(c ? wl : wr - 1) = buf[i];
+		wl += c;
+		wr -= !c;
+	}
+	return wl;
+}
+
+inline int* partitionBy(int* first, int* last, LessThan<int> p)
+{
+	return last - first >= 16 ? avx2Partition(first, last, Avx2IntLess(p.x)) : blockPartition(first, last, p);
+}
+
+inline int* partitionBy(int* first, int* last, NotGreater<int> p)
+{
+	return last - first >= 16 ? avx2Partition(first, last, Avx2IntNotGreater(p.x)) : blockPartition(first, last, p);
+}
+
+inline float* partitionBy(float* first, float* last, LessThan<float> p)
+{
+	return last - first >= 16 ? avx2Partition(first, last, Avx2FloatLess(p.x)) : blockPartition(first, last, p);
+}
+
+inline float* partitionBy(float* first, float* last, NotGreater<float> p)
+{
+	return last - first >= 16 ? avx2Partition(first, last, Avx2FloatNotGreater(p.x)) : blockPartition(first, last, p);
+}
+#endif
+
+// 其余类型 (以及未开 AVX2 时) 走无分支分块划分
+template<class T, class Pred>
+T* partitionBy(T* first, T* last, Pred p)
+{
+	return blockPartition(first, last, p);
+}
+
+template<class T>
+int median3(const std::vector<T>& A, int a, int b, int c)
+{
+	if (A[a] < A[b])
+		return A[b] < A[c] ? b : (A[a] < A[c] ? c : a);
+	return A[a] < A[c] ? a : (A[b] < A[c] ? c : b);
+}
+
+// 小区间三数取中, 大区间 ninther (三组三数取中再取中), 有序/逆序输入也能取到接近中位数的枢轴
+template<class T>
+int choosePivot(const std::vector<T>& A, int p, int r)
+{
+	int n = r-p+1;
+	int m = p + n/2;
+	if (n <= kNintherCutoff)
+		return median3(A, p, m, r);
+	int s = n/8;
+	return median3(A, median3(A, p, p+s, p+2*s), median3(A, m-s, m, m+s), median3(A, r-2*s, r-s, r));
+}
+
+// 以 A[p] 为枢轴划分 A[p..r], 返回枢轴最终位置 q: A[p..q-1] < A[q] <= A[q+1..r]
+template<class T>
+int partitionRight(std::vector<T>& A, int p, int r)
+{
+	T* a = A.data();
+	T* m = partitionBy(a + p + 1, a + r + 1, LessThan<T>{A[p]});
+	int q = int(m - a) - 1;
+	std::swap(A[p], A[q]);
+	return q;
+}
+
+// 调用方保证 A[p..r] 都不小于枢轴 A[p] 时使用 (如左邻就等于枢轴):
+// 把等于枢轴的元素集中到左侧, 返回第一个大于枢轴的位置. 大量重复值时一次跳过整段
+template<class T>
+int partitionLeft(std::vector<T>& A, int p, int r)
+{
+	T* a = A.data();
+	return int(partitionBy(a + p + 1, a + r + 1, NotGreater<T>{A[p]}) - a);
+}
+
+#endif
@@ -0,0 +1,393 @@
+// 外部归并排序: 输入为 int 二进制文件, 可远大于内存.
+// 1. 按内存预算分块读入, 每块用 InsertSort/main.cpp 中的并行 MergeSort 排好后写成一个 run 文件;
+// 2. 多路归并: 每个输入 run 和输出各有两块缓冲, 读线程预取下一块、写线程落盘上一块,
+//    归并线程只在内存里比较, 三者重叠. run 数超过路数时先分组归并成更长的 run, 再归并.
+// 内存预算同时决定 run 长度(预算 / 8 字节, 含 MergeSort 的一块临时缓冲)和归并路数.
+#define INSERTSORT_NO_MAIN
+#include "../InsertSort/main.cpp"
+
+#include <cstdio>
+#include <string>
+#include <future>
+#include <queue>
+#include <stdexcept>
+
+const size_t kMinIoBlock = size_t(1) << 20;   // 每块缓冲至少 1 MiB, 保证顺序大块读写
+
+// 单线程 I/O 队列, 任务按提交顺序执行, 结果与异常经 future 取回
+class IoWorker
+{
+public:
+    IoWorker() : stop(false), th([this]{ loop(); }) {}
+
+    ~IoWorker()
+    {
+        {
+            lock_guard<mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_one();
+        th.join();
+    }
+
+    future<size_t> submit(function<size_t()> f)
+    {
+        packaged_task<size_t()> task(move(f));
+        future<size_t> fut = task.get_future();
+        {
+            lock_guard<mutex> lk(m);
+            jobs.push_back(move(task));
+        }
+        cv.notify_one();
+        return fut;
+    }
+
+private:
+    void loop()
+    {
+        for(;;)
+        {
+            packaged_task<size_t()> task;
+            {
+                unique_lock<mutex> lk(m);
+                cv.wait(lk, [this]{ return stop || !jobs.empty(); });
+                if(jobs.empty())
+                    return;
+                task = move(jobs.front());
+                jobs.pop_front();
+            }
+            task();
+        }
+    }
+
+    mutex m;
+    condition_variable cv;
+    deque<packaged_task<size_t()>> jobs;
+    bool stop;
+    thread th;
+};
+
+FILE* OpenFile(const string& path, const char* mode)
+{
+    FILE* f = fopen(path.c_str(), mode);
+    if(!f)
+        throw runtime_error("ExternalSort: cannot open " + path);
+    return f;
+}
+
+size_t ReadInts(FILE* f, int* buf, size_t n, const string& path)
+{
+    size_t got = fread(buf, sizeof(int), n, f);
+    if(got < n && ferror(f))
+        throw runtime_error("ExternalSort: read failed on " + path);
+    return got;
+}
+
+void WriteInts(FILE* f, const int* buf, size_t n, const string& path)
+{
+    if(fwrite(buf, sizeof(int), n, f) != n)
+        throw runtime_error("ExternalSort: write failed on " + path);
+}
+
+// 顺序读一个 run: 消费一块时另一块已在读线程里预取
+class RunReader
+{
+public:
+    RunReader(const string& path, size_t block, IoWorker& io)
+        : path(path), f(OpenFile(path, "rb")), io(io), cur(0), pos(0), len(0)
+    {
+        buf[0].resize(block);
+        buf[1].resize(block);
+        len = ReadInts(f, buf[0].data(), block, path);
+        prefetch(1);
+    }
+
+    ~RunReader()
+    {
+        if(pending.valid())
+            pending.wait();
+        fclose(f);
+    }
+
+    bool empty() const { return pos == len; }
+    int front() const { return buf[cur][pos]; }
+
+    void pop()
+    {
+        if(++pos == len)
+            advance();
+    }
+
+private:
+    void prefetch(int i)
+    {
+        int* p = buf[i].data();
+        size_t n = buf[i].size();
+        pending = io.submit([this, p, n]{ return ReadInts(f, p, n, path); });
+    }
+
+    void advance()
+    {
+        if(!pending.valid())
+            return;                     // 文件已读完
+        size_t got = pending.get();
+        pos = 0;
+        len = got;
+        cur ^= 1;
+        if(got == buf[cur].size())
+            prefetch(cur ^ 1);
+    }
+
+    string path;
+    FILE* f;
+    IoWorker& io;
+    vector<int> buf[2];
+    int cur;
+    size_t pos, len;
+    future<size_t> pending;
+};
+
+// 顺序写: 一块交给写线程时继续填另一块
+class RunWriter
+{
+public:
+    RunWriter(const string& path, size_t block, IoWorker& io)
+        : path(path), f(OpenFile(path, "wb")), io(io), cur(0), len(0)
+    {
+        buf[0].resize(block);
+        buf[1].resize(block);
+    }
+
+    ~RunWriter()
+    {
+        if(pending.valid())
+            pending.wait();
+        if(f)
+            fclose(f);
+    }
+
+    void push(int x)
+    {
+        buf[cur][len++] = x;
+        if(len == buf[cur].size())
+            flush();
+    }
+
+    void close()
+    {
+        flush();
+        pending.get();
+        FILE* g = f;
+        f = nullptr;
+        if(fclose(g) != 0)
+            throw runtime_error("ExternalSort: write failed on " + path);
+    }
+
+private:
+    void flush()
+    {
+        if(pending.valid())
+            pending.get();
+        const int* p = buf[cur].data();
+        size_t n = len;
+        pending = io.submit([this, p, n]{ WriteInts(f, p, n, path); return n; });
+        cur ^= 1;
+        len = 0;
+    }
+
+    string path;
+    FILE* f;
+    IoWorker& io;
+    vector<int> buf[2];
+    int cur;
+    size_t len;
+    future<size_t> pending;
+};
+
+// k 路归并 inputs 到 output, 用最小堆选下一个元素
+void MergeRuns(const vector<string>& inputs, const string& output, size_t block, IoWorker& reader, IoWorker& writer)
+{
+    vector<unique_ptr<RunReader>> runs;
+    for(const string& path : inputs)
+        runs.emplace_back(new RunReader(path, block, reader));
+    RunWriter out(output, block, writer);
+
+    typedef pair<int, size_t> Head;
+    priority_queue<Head, vector<Head>, greater<Head>> heap;
+    for(size_t i = 0; i != runs.size(); ++i)
+        if(!runs[i]->empty())
+            heap.push(Head(runs[i]->front(), i));
+    while(!heap.empty())
+    {
+        size_t i = heap.top().second;
+        out.push(heap.top().first);
+        heap.pop();
+        runs[i]->pop();
+        if(!runs[i]->empty())
+            heap.push(Head(runs[i]->front(), i));
+    }
+    out.close();
+}
+
+// 将 input 排序写到 output; memoryBytes 为内存预算, 临时 run 文件放在 tmpDir 下, 结束后删除
+void ExternalSort(const string& input, const string& output, size_t memoryBytes, const string& tmpDir)
+{
+    if(memoryBytes < 8 * kMinIoBlock)
+        throw invalid_argument("ExternalSort: memory budget below 8 MiB");
+    const size_t runLen = min<size_t>(memoryBytes / (2 * sizeof(int)), 1u << 30);
+    // 每路两块缓冲, 输出两块: 2(k+1) 块共享预算
+    const size_t fanIn = max<size_t>(2, memoryBytes / (2 * kMinIoBlock) - 1);
+    const size_t block = memoryBytes / (2 * (fanIn + 1)) / sizeof(int);
+
+    // 1. 生成初始 run
+    vector<string> runs;
+    {
+        FILE* in = OpenFile(input, "rb");
+        vector<int> A(runLen);
+        try
+        {
+            for(;;)
+            {
+                size_t n = ReadInts(in, A.data(), runLen, input);
+                if(n == 0)
+                    break;
+                A.resize(n);
+                MergeSort(A, 0, int(n) - 1);
+                string path = tmpDir + "/run_0_" + to_string(runs.size()) + ".bin";
+                FILE* f = OpenFile(path, "wb");
+                runs.push_back(path);
+                WriteInts(f, A.data(), n, path);
+                if(fclose(f) != 0)
+                    throw runtime_error("ExternalSort: write failed on " + path);
+                if(n < runLen)
+                    break;
+            }
+        }
+        catch(...)
+        {
+            fclose(in);
+            for(const string& path : runs)
+                remove(path.c_str());
+            throw;
+        }
+        fclose(in);
+    }
+    if(runs.empty())
+    {
+        fclose(OpenFile(output, "wb"));
+        return;
+    }
+
+    // 2. 逐趟多路归并, 直到一趟即可写出结果. 最后一趟先写到临时名, 成功后再改名,
+    // 失败时不会留下截断的 output; 本趟已写出和写了一半的 run 都在 next 里, 一并删除
+    IoWorker reader, writer;
+    const string partial = output + ".partial";
+    vector<string> next;
+    try
+    {
+        for(int pass = 1; ; ++pass)
+        {
+            if(runs.size() <= fanIn)
+            {
+                MergeRuns(runs, partial, block, reader, writer);
+                if(rename(partial.c_str(), output.c_str()) != 0)
+                    throw runtime_error("ExternalSort: cannot rename " + partial + " to " + output);
+                break;
+            }
+            for(size_t i = 0; i < runs.size(); i += fanIn)
+            {
+                vector<string> group(runs.begin() + i, runs.begin() + min(runs.size(), i + fanIn));
+                string path = tmpDir + "/run_" + to_string(pass) + "_" + to_string(next.size()) + ".bin";
+                next.push_back(path);
+                MergeRuns(group, path, block, reader, writer);
+                for(const string& p : group)
+                    remove(p.c_str());
+            }
+            runs.swap(next);
+            next.clear();
+        }
+    }
+    catch(...)
+    {
+        for(const string& path : runs)
+            remove(path.c_str());
+        for(const string& path : next)
+            remove(path.c_str());
+        remove(partial.c_str());
+        throw;
+    }
+    for(const string& path : runs)
+        remove(path.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    // 用法: ExternalSort [元素个数] [内存预算 MiB] [临时目录]
+    const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000000;
+    const size_t budget = (argc > 2 ? strtoull(argv[2], nullptr, 10) : 64) << 20;
+    const string dir = argc > 3 ? argv[3] : ".";
+    const string input = dir + "/unsorted.bin", output = dir + "/sorted.bin";
+
+    try
+    {
+        // 生成随机输入, 同时记下元素和与异或和用于校验
+        mt19937 rng(random_device{}());
+        uint64_t sum = 0, xr = 0;
+        {
+            FILE* f = OpenFile(input, "wb");
+            vector<int> buf(kMinIoBlock / sizeof(int));
+            for(size_t done = 0; done < n; )
+            {
+                size_t m = min(buf.size(), n - done);
+                for(size_t i = 0; i != m; ++i)
+                {
+                    buf[i] = int(rng());
+                    sum += uint32_t(buf[i]);
+                    xr ^= uint32_t(buf[i]);
+                }
+                WriteInts(f, buf.data(), m, input);
+                done += m;
+            }
+            fclose(f);
+        }
+
+        auto start = chrono::steady_clock::now();
+        ExternalSort(input, output, budget, dir);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // 流式校验有序性、元素个数与校验和
+        FILE* f = OpenFile(output, "rb");
+        vector<int> buf(kMinIoBlock / sizeof(int));
+        size_t count = 0;
+        uint64_t sum2 = 0, xr2 = 0;
+        bool sorted = true;
+        int last = 0;
+        for(size_t m; (m = ReadInts(f, buf.data(), buf.size(), output)) != 0; )
+        {
+            for(size_t i = 0; i != m; ++i)
+            {
+                if(count + i > 0 && buf[i] < last)
+                    sorted = false;
+                last = buf[i];
+                sum2 += uint32_t(buf[i]);
+                xr2 ^= uint32_t(buf[i]);
+            }
+            count += m;
+        }
+        fclose(f);
+        remove(input.c_str());
+        remove(output.c_str());
+
+        bool ok = sorted && count == n && sum == sum2 && xr == xr2;
+        cout << "ExternalSort " << n << " ints, budget " << (budget >> 20) << " MiB: " << secs << " s, "
+             << (ok ? "ok" : "MISMATCH") << endl;
+        return ok ? 0 : 1;
+    }
+    catch(const exception& e)
+    {
+        cerr << e.what() << endl;
+        remove(input.c_str());
+        remove(output.c_str());
+        return 1;
+    }
+}
@@ -17,7 +17,7 @@ void CreatHeap(int *nums,int numsSize)
 {
 	int n=numsSize;
 	for(int i=(n-1)/2;i>=0;--i)
-		HeapAdjust(nums,i,numsSize);
+		HeapAdjust(nums,i,numsSize-1);
 }
 //堆排序
 void HeapSort(int *nums,int numsSize)
@@ -33,6 +33,8 @@ void HeapSort(int *nums,int numsSize)
 	}
 }
 
+//编译时定义 HEAPSORT_NO_MAIN 则不生成 main，供 Quicksort/main.cpp 直接包含作为退化时的兜底
+#ifndef HEAPSORT_NO_MAIN
 int main(void)
 {
 	int nums[]={49,38,65,97,76,13,27,49};
@@ -45,3 +47,4 @@ int main(void)
 
 	return 0;
 }
+#endif
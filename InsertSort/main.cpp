@@ -1,79 +1,307 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <numeric>
+#include <cstdlib>
 
 using namespace std;
 void InsertSort(vector<int> &A, int n);
 void MergeSort(vector<int> &A, int p, int r);
 
-int main()
+// 编译时定义 INSERTSORT_NO_MAIN 则不生成 main，供外部排序（ExternalSort/main.cpp）直接包含本文件
+#ifndef INSERTSORT_NO_MAIN
+int main(int argc, char* argv[])
 {
     cout << "Hello world!" << endl;
-    const int n = 1000000000;
-    vector<int> A;
-    for(int i=0; i != n; ++i)
-        A.push_back(i);
-    random_shuffle(A.begin(),A.end());
+    const int n = argc > 1 ? atoi(argv[1]) : 1000000000;
+    vector<int> A(n);
+    iota(A.begin(), A.end(), 0);
+    shuffle(A.begin(), A.end(), mt19937(random_device()()));
     //InsertSort(A,n);
-    //MergeSort(A, 0, n-1);
+    auto start = chrono::steady_clock::now();
+    MergeSort(A, 0, n-1);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "MergeSort " << n << " ints on " << thread::hardware_concurrency() << " cores: "
+         << secs << " s, " << (is_sorted(A.begin(), A.end()) ? "sorted" : "NOT sorted") << endl;
     return 0;
 }
+#endif
 
-void InsertSort(vector<int> &A, int n)
+void InsertSort(int* A, size_t n)
 {
-    for(int j = 1; j< n; ++j)
+    for(size_t j = 1; j < n; ++j)
     {
         int x = A[j];
-        int i = j - 1;
-        while(i >= 0 && x < A[i])
+        size_t i = j;
+        while(i > 0 && x < A[i-1])
         {
-            A[i+1] = A[i];
-            i = i - 1;
+            A[i] = A[i-1];
+            --i;
         }
-        A[i+1] = x;
+        A[i] = x;
     }
 }
 
-void Merge(vector<int> &A, int p, int q, int r)
+void InsertSort(vector<int> &A, int n)
+{
+    InsertSort(A.data(), n);
+}
+
+// 工作窃取任务池: 每个 worker 一个双端队列, 自己从尾部取(LIFO, 缓存热),
+// 空闲时从别人头部偷(FIFO, 偷到的是最大的子任务). 调用 run() 的线程充当 0 号 worker.
+class TaskPool
 {
-    int* B = new int[q-p+1];
-    int* C = new int[r-q];
-    int x = q-p+1, y = r-q;
-    for(int i=p,j=0; i<=q; ++i,++j)
-        B[j] = A[i];
-    for(int i=q+1,j=0; i<=r; ++i,++j)
-        C[j] = A[i];
-    int i = 0, j = 0, k = p;
-    while(i<x && j<y)
-    {
-        if(B[i]<=C[j])
+public:
+    struct Group
+    {
+        atomic<size_t> pending{0};
+    };
+
+    explicit TaskPool(unsigned n = thread::hardware_concurrency())
+        : stop(false), queued(0)
+    {
+        if(n == 0)
+            n = 1;
+        for(unsigned i = 0; i != n; ++i)
+            workers.emplace_back(new Worker);
+        for(unsigned i = 1; i != n; ++i)
+            threads.emplace_back([this, i]{ loop(i); });
+    }
+
+    ~TaskPool()
+    {
         {
-            A[k] = B[i];
-            ++i;
+            lock_guard<mutex> lk(sleepMutex);
+            stop = true;
         }
-        else
+        wake.notify_all();
+        for(auto& t : threads)
+            t.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    template<class F>
+    void run(F f)
+    {
+        lock_guard<mutex> lk(runMutex);
+        self() = 0;
+        f();
+        self() = -1;
+    }
+
+    // 只能在 run() 内或任务内调用
+    void spawn(Group& g, function<void()> f)
+    {
+        g.pending.fetch_add(1, memory_order_relaxed);
+        Worker& w = *workers[self()];
+        {
+            lock_guard<mutex> lk(w.m);
+            w.q.push_back(Task{move(f), &g});
+        }
+        queued.fetch_add(1, memory_order_release);
         {
-            A[k] = C[j];
-            ++j;
+            lock_guard<mutex> lk(sleepMutex);
         }
-        ++k;
+        wake.notify_one();
     }
-    if(i==x)
-        while(j<y) A[k++] = C[j++];
-    else
-        while(i<x) A[k++] = B[i++];
-    delete [] B;
-    delete [] C;
+
+    // 等待期间不阻塞, 继续执行自己或别人的任务
+    void wait(Group& g)
+    {
+        while(g.pending.load(memory_order_acquire) != 0)
+        {
+            Task t;
+            if(take(self(), t))
+                execute(t);
+            else
+                this_thread::yield();
+        }
+    }
+
+private:
+    struct Task
+    {
+        function<void()> fn;
+        Group* group;
+    };
+    struct Worker
+    {
+        mutex m;
+        deque<Task> q;
+    };
+
+    static int& self()
+    {
+        thread_local int id = -1;
+        return id;
+    }
+
+    bool take(int id, Task& t)
+    {
+        {
+            Worker& w = *workers[id];
+            lock_guard<mutex> lk(w.m);
+            if(!w.q.empty())
+            {
+                t = move(w.q.back());
+                w.q.pop_back();
+                queued.fetch_sub(1, memory_order_relaxed);
+                return true;
+            }
+        }
+        size_t n = workers.size();
+        for(size_t k = 1; k < n; ++k)
+        {
+            Worker& v = *workers[(id + k) % n];
+            lock_guard<mutex> lk(v.m);
+            if(!v.q.empty())
+            {
+                t = move(v.q.front());
+                v.q.pop_front();
+                queued.fetch_sub(1, memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(Task& t)
+    {
+        t.fn();
+        t.group->pending.fetch_sub(1, memory_order_release);
+    }
+
+    void loop(int id)
+    {
+        self() = id;
+        for(;;)
+        {
+            Task t;
+            if(take(id, t))
+            {
+                execute(t);
+                continue;
+            }
+            unique_lock<mutex> lk(sleepMutex);
+            wake.wait(lk, [this]{ return stop || queued.load(memory_order_acquire) > 0; });
+            if(stop)
+                return;
+        }
+    }
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    bool stop;
+    atomic<size_t> queued;
+    mutex sleepMutex;
+    condition_variable wake;
+    mutex runMutex;
+};
+
+const size_t kInsertCutoff = 32;         // 小区间直接插入排序
+const size_t kSpawnCutoff = 1 << 15;     // 小于此长度不再拆任务
+const size_t kMergeChunk = 1 << 16;      // 并行归并每块输出长度
+
+// 稳定归并 a[0,na) 与 b[0,nb) 到 out
+void Merge(const int* a, size_t na, const int* b, size_t nb, int* out)
+{
+    size_t i = 0, j = 0, k = 0;
+    while(i < na && j < nb)
+    {
+        if(a[i] <= b[j])
+            out[k++] = a[i++];
+        else
+            out[k++] = b[j++];
+    }
+    while(i < na) out[k++] = a[i++];
+    while(j < nb) out[k++] = b[j++];
 }
-void MergeSort(vector<int> &A, int p, int r)
+
+// co-rank: 归并结果前 k 个元素中来自 a 的个数 i (其余 k-i 个来自 b), 二分求解
+size_t CoRank(size_t k, const int* a, size_t na, const int* b, size_t nb)
 {
-    int q;
-    if(p < r)
+    size_t lo = k > nb ? k - nb : 0;
+    size_t hi = min(k, na);
+    for(;;)
     {
-        q = (p + r)/2;
-        MergeSort(A, p, q);
-        MergeSort(A, q+1, r);
-        Merge(A, p, q, r);
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = k - i;
+        if(i < na && j > 0 && a[i] <= b[j-1])
+            lo = i + 1;
+        else if(i > 0 && j < nb && b[j] < a[i-1])
+            hi = i - 1;
+        else
+            return i;
     }
+}
 
+// 输出切成若干等长块, 每块用 co-rank 定位两边的起止, 各块独立归并
+void ParallelMerge(TaskPool& pool, const int* a, size_t na, const int* b, size_t nb, int* out)
+{
+    size_t n = na + nb;
+    if(n <= kMergeChunk || pool.size() == 1)
+    {
+        Merge(a, na, b, nb, out);
+        return;
+    }
+    TaskPool::Group g;
+    for(size_t k0 = 0; k0 < n; k0 += kMergeChunk)
+    {
+        size_t k1 = min(n, k0 + kMergeChunk);
+        pool.spawn(g, [=]
+        {
+            size_t i0 = CoRank(k0, a, na, b, nb), i1 = CoRank(k1, a, na, b, nb);
+            Merge(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), out + k0);
+        });
+    }
+    pool.wait(g);
+}
+
+// 排序 A[0,n), 结果放在 toB ? B : A. 两半的结果放进另一块缓冲, 再归并回目标,
+// 每层源和目标交替, 整个排序只用一块预分配的 B
+void MergeSort(TaskPool& pool, int* A, int* B, size_t n, bool toB)
+{
+    if(n <= kInsertCutoff)
+    {
+        InsertSort(A, n);
+        if(toB)
+            copy(A, A + n, B);
+        return;
+    }
+    size_t m = n / 2;
+    if(n >= kSpawnCutoff && pool.size() > 1)
+    {
+        TaskPool::Group g;
+        pool.spawn(g, [&]{ MergeSort(pool, A, B, m, !toB); });
+        MergeSort(pool, A + m, B + m, n - m, !toB);
+        pool.wait(g);
+    }
+    else
+    {
+        MergeSort(pool, A, B, m, !toB);
+        MergeSort(pool, A + m, B + m, n - m, !toB);
+    }
+    const int* src = toB ? A : B;
+    int* dst = toB ? B : A;
+    ParallelMerge(pool, src, m, src + m, n - m, dst);
+}
+
+void MergeSort(vector<int> &A, int p, int r)
+{
+    if(p >= r)
+        return;
+    static TaskPool pool;
+    size_t n = size_t(r) - p + 1;
+    unique_ptr<int[]> B(new int[n]);
+    pool.run([&]{ MergeSort(pool, A.data() + p, B.get(), n, false); });
 }
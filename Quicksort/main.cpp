@@ -1,40 +1,96 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <random>
+
+#define HEAPSORT_NO_MAIN
+#include "../HeapSort.c"
+#include "../BlockPartition.h"
 
 using namespace std;
 
-int partition(vector<int>& A, int p, int r)
+const int kInsertionCutoff = 16;	// 不超过此长度的区间用插入排序
+
+void insertionSort(vector<int>& A, int p, int r)
 {
-	int x = A[r];
-	int i = p-1;
-	for (int j=p; j<=r-1; ++j) {
-		if(A[j]<=x) {
-			++i;
-			swap(A[i], A[j]);
+	for (int j=p+1; j<=r; ++j) {
+		int x = A[j];
+		int i = j-1;
+		while (i >= p && x < A[i]) {
+			A[i+1] = A[i];
+			--i;
 		}
+		A[i+1] = x;
 	}
-	swap(A[i+1], A[r])
-	return i+1;
 }
 
-
-void quicksort(vector<int>& A, int p, int r) {
+// 只对较短的一侧递归, 较长的一侧继续循环, 栈深 O(log n);
+// 划分层数超过 depth 时说明枢轴持续很差, 剩余区间改用堆排序, 保证 O(n log n).
+// 不是最左的区间时, 左邻 A[p-1] 不大于区间内任何元素; 若枢轴与它相等, 区间里没有更小的元素,
+// 把与枢轴相等的一段整体归位后跳过, 大量重复值时不会退化
+void introsort(vector<int>& A, int p, int r, int depth, bool leftmost)
 {
-	while (p < r) {
-		int q = partition(A, p, r);
-		quicksort(A, p, q-1);
-		quicksort(A, q+1, r);
+	while (r-p+1 > kInsertionCutoff) {
+		if (depth == 0) {
+			HeapSort(A.data()+p, r-p+1);
+			return;
+		}
+		--depth;
+		swap(A[p], A[choosePivot(A, p, r)]);
+		if (!leftmost && !(A[p-1] < A[p])) {
+			p = partitionLeft(A, p, r);
+			continue;
+		}
+		int q = partitionRight(A, p, r);
+		if (q-p < r-q) {
+			introsort(A, p, q-1, depth, leftmost);
+			p = q+1;
+			leftmost = false;
+		} else {
+			introsort(A, q+1, r, depth, false);
+			r = q-1;
+		}
 	}
+	insertionSort(A, p, r);
+}
+
+void quicksort(vector<int>& A, int p, int r)
+{
+	if (p >= r)
+		return;
+	int depth = 0;
+	for (int n = r-p+1; n > 1; n >>= 1)
+		depth += 2;
+	introsort(A, p, r, depth, true);
 }
 
 int main()
 {
-    cout << "Hello world!" << endl;
-    std::vector<int> A = { 27, 99, 0, 8, 13, 64, 86, 16, 7, 10, 88, 25, 90};
-    for_each(A.begin(),A.end(),[](int a){ std::cout << a << " ";});
-    std::cout << std::endl;
-    quicksort(A, 0, A.size()-1);
-    for_each(A.begin(),A.end(),[](int a){ std::cout << a << " ";});
-    return 0;
+	cout << "Hello world!" << endl;
+	std::vector<int> A = { 27, 99, 0, 8, 13, 64, 86, 16, 7, 10, 88, 25, 90};
+	for_each(A.begin(),A.end(),[](int a){ std::cout << a << " ";});
+	std::cout << std::endl;
+	quicksort(A, 0, A.size()-1);
+	for_each(A.begin(),A.end(),[](int a){ std::cout << a << " ";});
+	std::cout << std::endl;
+
+	// 有序、逆序、大量重复、随机输入
+	const int n = 10000000;
+	mt19937 rng(1);
+	vector<vector<int>> inputs(4, vector<int>(n));
+	const char* names[] = { "sorted", "reversed", "few distinct", "random" };
+	for (int i=0; i<n; ++i) {
+		inputs[0][i] = i;
+		inputs[1][i] = n-i;
+		inputs[2][i] = rng() % 4;
+		inputs[3][i] = rng();
+	}
+	for (int k=0; k<4; ++k) {
+		auto start = chrono::steady_clock::now();
+		quicksort(inputs[k], 0, n-1);
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		cout << names[k] << ": " << ms << " ms, " << (is_sorted(inputs[k].begin(), inputs[k].end()) ? "sorted" : "NOT sorted") << endl;
+	}
+	return 0;
 }
@@ -0,0 +1,360 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <type_traits>
+
+using namespace std;
+
+// 基数排序: 每位 8 bit, 一遍扫描统计所有位的直方图, 全部落在同一桶的位直接跳过.
+// 键先映射成保序的无符号位模式: 有符号数翻转符号位, 浮点负数按位取反、非负数翻转符号位
+// (因此 -0.0 排在 +0.0 前, NaN 按位模式排在两端).
+
+const int kRadixBits = 8;
+const size_t kBuckets = size_t(1) << kRadixBits;
+const size_t kRadixInsertCutoff = 64;      // 小区间插入排序
+const size_t kParallelCutoff = 1 << 16;    // 小于此长度不开线程
+
+template<class T, class Enable = void>
+struct RadixKey;
+
+template<class T>
+struct RadixKey<T, typename enable_if<is_integral<T>::value>::type>
+{
+    typedef typename make_unsigned<T>::type bits_type;
+    static bits_type encode(T x)
+    {
+        bits_type b = bits_type(x);
+        if(is_signed<T>::value)
+            b ^= bits_type(bits_type(1) << (sizeof(T) * 8 - 1));
+        return b;
+    }
+};
+
+template<class T>
+struct RadixKey<T, typename enable_if<is_floating_point<T>::value>::type>
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "RadixKey: only float and double");
+    typedef typename conditional<sizeof(T) == 4, uint32_t, uint64_t>::type bits_type;
+    static bits_type encode(T x)
+    {
+        bits_type b;
+        memcpy(&b, &x, sizeof b);
+        const bits_type sign = bits_type(1) << (sizeof(T) * 8 - 1);
+        return (b & sign) ? bits_type(~b) : bits_type(b | sign);
+    }
+};
+
+template<class T>
+inline size_t RadixDigit(T x, int d)
+{
+    return size_t(RadixKey<T>::encode(x) >> (d * kRadixBits)) & (kBuckets - 1);
+}
+
+// 只排键时的占位 payload 类型
+struct NoPayload {};
+
+template<class V>
+struct HasPayload : integral_constant<bool, !is_same<V, NoPayload>::value> {};
+
+// 稳定插入排序, payload 跟随键移动
+template<class T, class V>
+void RadixInsertSort(T* k, V* v, size_t n)
+{
+    for(size_t j = 1; j < n; ++j)
+    {
+        T x = k[j];
+        typename RadixKey<T>::bits_type bx = RadixKey<T>::encode(x);
+        size_t i = j;
+        if(HasPayload<V>::value)
+        {
+            V y = v[j];
+            while(i > 0 && bx < RadixKey<T>::encode(k[i-1]))
+            {
+                k[i] = k[i-1];
+                v[i] = v[i-1];
+                --i;
+            }
+            k[i] = x;
+            v[i] = y;
+        }
+        else
+        {
+            while(i > 0 && bx < RadixKey<T>::encode(k[i-1]))
+            {
+                k[i] = k[i-1];
+                --i;
+            }
+            k[i] = x;
+        }
+    }
+}
+
+// 一遍扫描统计所有位, h 为 sizeof(T) 行 kBuckets 列, 需预先清零
+template<class T>
+void RadixHistogram(const T* k, size_t n, size_t (*h)[kBuckets])
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        typename RadixKey<T>::bits_type b = RadixKey<T>::encode(k[i]);
+        for(int d = 0; d < int(sizeof(T)); ++d)
+            ++h[d][size_t(b >> (d * kRadixBits)) & (kBuckets - 1)];
+    }
+}
+
+// 第 d 位是否在 n 个元素上恒定
+inline bool RadixConstant(const size_t* c, size_t n)
+{
+    for(size_t b = 0; b != kBuckets; ++b)
+        if(c[b] != 0)
+            return c[b] == n;
+    return true;
+}
+
+// 按第 d 位稳定分发, off 为各桶写入位置(随写随推进)
+template<class T, class V>
+void RadixScatter(const T* ks, T* kd, const V* vs, V* vd, size_t n, int d, size_t* off)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t pos = off[RadixDigit(ks[i], d)]++;
+        kd[pos] = ks[i];
+        if(HasPayload<V>::value)
+            vd[pos] = vs[i];
+    }
+}
+
+// LSD: 低 digits 位从低到高逐位分发, k/tk 交替作源和目标. 返回结果是否落在 tk
+template<class T, class V>
+bool RadixSortLSD(T* k, V* v, T* tk, V* tv, size_t n, size_t (*h)[kBuckets], int digits)
+{
+    T* ks = k;
+    T* kd = tk;
+    V* vs = v;
+    V* vd = tv;
+    for(int d = 0; d < digits; ++d)
+    {
+        if(RadixConstant(h[d], n))
+            continue;
+        size_t off[kBuckets], sum = 0;
+        for(size_t b = 0; b != kBuckets; ++b)
+        {
+            off[b] = sum;
+            sum += h[d][b];
+        }
+        RadixScatter(ks, kd, vs, vd, n, d, off);
+        swap(ks, kd);
+        swap(vs, vd);
+    }
+    return ks != k;
+}
+
+// 排序 k[0,n) 到 k 或 tk 中, 返回结果是否落在 tk
+template<class T, class V>
+bool RadixSortRange(T* k, V* v, T* tk, V* tv, size_t n, int digits)
+{
+    if(n <= kRadixInsertCutoff)
+    {
+        RadixInsertSort(k, v, n);
+        return false;
+    }
+    size_t h[sizeof(T)][kBuckets] = {};
+    RadixHistogram(k, n, h);
+    return RadixSortLSD(k, v, tk, tv, n, h, digits);
+}
+
+template<class T, class V>
+void RadixMoveBack(T* k, V* v, const T* tk, const V* tv, size_t n)
+{
+    copy(tk, tk + n, k);
+    if(HasPayload<V>::value)
+        copy(tv, tv + n, v);
+}
+
+template<class T, class V>
+void RadixSortImpl(T* k, V* v, size_t n)
+{
+    if(n <= kRadixInsertCutoff)
+    {
+        RadixInsertSort(k, v, n);
+        return;
+    }
+    vector<T> tk(n);
+    vector<V> tv(HasPayload<V>::value ? n : 0);
+    if(RadixSortRange(k, v, tk.data(), tv.data(), n, int(sizeof(T))))
+        RadixMoveBack(k, v, tk.data(), tv.data(), n);
+}
+
+template<class F>
+void RadixParallelFor(unsigned p, F f)
+{
+    vector<thread> threads;
+    for(unsigned t = 1; t < p; ++t)
+        threads.emplace_back(f, t);
+    f(0u);
+    for(auto& th : threads)
+        th.join();
+}
+
+// 多线程: 各线程统计本段直方图(一遍得到所有位), 按最高的非恒定位做一次 MSD 分发,
+// 每个线程在每个桶里的写入区间由前缀和事先算好, 互不重叠且保持稳定;
+// 之后各桶互相独立, 由线程动态领取, 桶内对剩余低位做 LSD
+template<class T, class V>
+void ParallelRadixSortImpl(T* k, V* v, size_t n, unsigned p)
+{
+    if(p == 0)
+        p = thread::hardware_concurrency();
+    if(p <= 1 || n < kParallelCutoff)
+    {
+        RadixSortImpl(k, v, n);
+        return;
+    }
+    const int D = int(sizeof(T));
+    vector<size_t> hist(size_t(p) * D * kBuckets);
+    auto local = [&](unsigned t) { return reinterpret_cast<size_t (*)[kBuckets]>(&hist[size_t(t) * D * kBuckets]); };
+    auto lo = [&](unsigned t) { return n / p * t + min<size_t>(t, n % p); };
+
+    RadixParallelFor(p, [&](unsigned t)
+    {
+        RadixHistogram(k + lo(t), lo(t + 1) - lo(t), local(t));
+    });
+
+    size_t total[kBuckets];
+    int top = -1;
+    for(int d = D - 1; d >= 0 && top < 0; --d)
+    {
+        for(size_t b = 0; b != kBuckets; ++b)
+        {
+            total[b] = 0;
+            for(unsigned t = 0; t != p; ++t)
+                total[b] += local(t)[d][b];
+        }
+        if(!RadixConstant(total, n))
+            top = d;
+    }
+    if(top < 0)
+        return;
+
+    size_t start[kBuckets + 1];
+    start[0] = 0;
+    for(size_t b = 0; b != kBuckets; ++b)
+        start[b+1] = start[b] + total[b];
+
+    vector<T> tk(n);
+    vector<V> tv(HasPayload<V>::value ? n : 0);
+    RadixParallelFor(p, [&](unsigned t)
+    {
+        size_t off[kBuckets];
+        for(size_t b = 0; b != kBuckets; ++b)
+        {
+            off[b] = start[b];
+            for(unsigned s = 0; s != t; ++s)
+                off[b] += local(s)[top][b];
+        }
+        size_t l = lo(t);
+        RadixScatter(k + l, tk.data(), v + (HasPayload<V>::value ? l : 0), tv.data(), lo(t + 1) - l, top, off);
+    });
+
+    atomic<size_t> next(0);
+    RadixParallelFor(p, [&](unsigned)
+    {
+        for(size_t b; (b = next.fetch_add(1)) < kBuckets; )
+        {
+            size_t s = start[b], m = start[b+1] - s;
+            if(m == 0)
+                continue;
+            T* bk = tk.data() + s;
+            V* bv = HasPayload<V>::value ? tv.data() + s : nullptr;
+            V* ov = HasPayload<V>::value ? v + s : nullptr;
+            if(!RadixSortRange(bk, bv, k + s, ov, m, top))
+                RadixMoveBack(k + s, ov, bk, bv, m);
+        }
+    });
+}
+
+// 只排键
+template<class T>
+void RadixSort(T* a, size_t n)
+{
+    RadixSortImpl(a, static_cast<NoPayload*>(nullptr), n);
+}
+
+// 键 + payload(如记录 ID), payload 随键一起重排, 相等键保持原有次序
+template<class T, class V>
+void RadixSort(T* keys, V* vals, size_t n)
+{
+    RadixSortImpl(keys, vals, n);
+}
+
+// threads 为 0 时取硬件线程数
+template<class T>
+void ParallelRadixSort(T* a, size_t n, unsigned threads = 0)
+{
+    ParallelRadixSortImpl(a, static_cast<NoPayload*>(nullptr), n, threads);
+}
+
+template<class T, class V>
+void ParallelRadixSort(T* keys, V* vals, size_t n, unsigned threads = 0)
+{
+    ParallelRadixSortImpl(keys, vals, n, threads);
+}
+
+template<class T, class F>
+void RadixDemo(const char* name, vector<T> A, F sortFn)
+{
+    vector<T> B = A;
+    auto t0 = chrono::steady_clock::now();
+    sortFn(A.data(), A.size());
+    auto t1 = chrono::steady_clock::now();
+    sort(B.begin(), B.end());
+    auto t2 = chrono::steady_clock::now();
+    cout << name << ": radix " << chrono::duration<double, milli>(t1 - t0).count() << " ms, std::sort "
+         << chrono::duration<double, milli>(t2 - t1).count() << " ms, " << (A == B ? "ok" : "MISMATCH") << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    mt19937_64 rng(42);
+
+    vector<int32_t> i32(n);
+    for(auto& x : i32) x = int32_t(rng());
+    vector<int64_t> i64(n);
+    for(auto& x : i64) x = int64_t(rng());
+    vector<uint32_t> small(n);
+    for(auto& x : small) x = uint32_t(rng() % 1000000);
+    vector<float> f32(n);
+    for(auto& x : f32) x = float(int64_t(rng() % 2000001) - 1000000) / 7.0f;
+    vector<double> f64(n);
+    for(auto& x : f64) x = double(int64_t(rng())) / 3.0;
+
+    RadixDemo("int32        ", i32, [](int32_t* a, size_t m) { RadixSort(a, m); });
+    RadixDemo("int64        ", i64, [](int64_t* a, size_t m) { RadixSort(a, m); });
+    RadixDemo("uint32 < 1e6 ", small, [](uint32_t* a, size_t m) { RadixSort(a, m); });
+    RadixDemo("float        ", f32, [](float* a, size_t m) { RadixSort(a, m); });
+    RadixDemo("double       ", f64, [](double* a, size_t m) { RadixSort(a, m); });
+    RadixDemo("int32 threads", i32, [](int32_t* a, size_t m) { ParallelRadixSort(a, m); });
+    RadixDemo("int64 threads", i64, [](int64_t* a, size_t m) { ParallelRadixSort(a, m); });
+
+    // 键 + 记录 ID: 排序后 ID 仍指向原键, 相等键的 ID 递增(稳定)
+    vector<uint32_t> keys = small, ids(n);
+    for(size_t i = 0; i != n; ++i) ids[i] = uint32_t(i);
+    ParallelRadixSort(keys.data(), ids.data(), n);
+    bool ok = true;
+    for(size_t i = 0; i != n; ++i)
+    {
+        if(keys[i] != small[ids[i]] || (i > 0 && (keys[i-1] > keys[i] || (keys[i-1] == keys[i] && ids[i-1] > ids[i]))))
+        {
+            ok = false;
+            break;
+        }
+    }
+    cout << "key+id       : " << (ok ? "ok" : "MISMATCH") << endl;
+    return 0;
+}
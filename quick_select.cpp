@@ -1,28 +1,49 @@
-int partition(vector<int>& A, int p, int r)
-{
-	int x = A[r];
-	int i = p-1;
-	for (int j=p; j<=r-1; ++j) {
-		if(A[j]<=x) {
-			++i;
-			swap(A[i], A[j]);
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+#include "BlockPartition.h"
+
+using namespace std;
+
+// 返回 A[p..r] 中第 i 小的元素 (i 从 1 开始), 会打乱 A[p..r]
+int quickselect(vector<int>& A, int p, int r, int i) {
+	const int lo = p;
+	while (r-p+1 > 16) {
+		swap(A[p], A[choosePivot(A, p, r)]);
+		// 左邻 A[p-1] 不大于区间内任何元素, 若与枢轴相等则区间内没有更小的, 整段跳过等于枢轴的元素
+		if (p > lo && !(A[p-1] < A[p])) {
+			int m = partitionLeft(A, p, r);
+			if (i <= m-p) {
+				return A[p];
+			}
+			i -= m-p;
+			p = m;
+			continue;
+		}
+		int q = partitionRight(A, p, r);
+		int k = q-p+1;
+		if (i == k) {
+			return A[q];
+		} else if (i<k) {
+			r = q-1;
+		} else {
+			i -= k;
+			p = q+1;
 		}
 	}
-	swap(A[i+1], A[r])
-	return i+1;
+	sort(A.begin()+p, A.begin()+r+1);
+	return A[p+i-1];
 }
 
-int quickselect(vector<int>& A, int p, int r, int i) {
-	if (p==r) {
-		return A[p];
-	}
-	q = partition(A, p, r);
-	int k = q-p+1;
-	if (i == k) {
-		return A[q];
-	} else if (i<k) {
-		return quickselect(A, p, q-1, i);
-	} else {
-		return quickselect(A, q+1, r, i-k);
+int main()
+{
+	std::vector<int> A = { 27, 99, 0, 8, 13, 64, 86, 16, 7, 10, 88, 25, 90};
+	for (int i=1; i<=(int)A.size(); ++i) {
+		std::vector<int> B = A;
+		std::cout << quickselect(B, 0, B.size()-1, i) << " ";
 	}
+	std::cout << std::endl;
+	return 0;
 }